@@ -0,0 +1,275 @@
+#pragma once
+
+#include "Memory.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief ComponentInfo describes how to handle a component type without knowing it
+ */
+struct ComponentInfo {
+    std::size_t size = 0;
+    std::size_t alignment = 1;
+    void (*move)(void* destination, void* source) = nullptr;
+    void (*destroy)(void* component) = nullptr;
+
+    /**
+     * @brief Create the ComponentInfo of a component type
+     * @tparam ComponentT Type of the component
+     * @return ComponentInfo of the component type
+     */
+    template<typename ComponentT>
+    static ComponentInfo of()
+    {
+        return (ComponentInfo {
+            sizeof(ComponentT),
+            alignof(ComponentT),
+            [](void* destination, void* source) { new (destination) ComponentT(std::move(*static_cast<ComponentT*>(source))); },
+            [](void* component) { static_cast<ComponentT*>(component)->~ComponentT(); } });
+    }
+};
+
+/**
+ * @brief Archetype stores every entity sharing the same Signature in fixed-size chunks
+ *
+ * A chunk is a CHUNK_SIZE block laid out as structure of arrays: the entities first, then one
+ * cache-line aligned column per component type of the signature, all of them `capacity()` long.
+ * Rows are kept packed, removing a row moves the last row in its place. Chunks are allocated from the
+ * memory resource given at construction.
+ */
+class Archetype {
+public:
+    /**
+     * @brief Size in bytes of a chunk
+     */
+    static constexpr std::size_t CHUNK_SIZE = 16 * 1024;
+    /**
+     * @brief Alignment of chunks and of every column inside them
+     */
+    static constexpr std::size_t COLUMN_ALIGNMENT = 64;
+
+    /**
+     * @brief Construct a new Archetype object
+     * @param signature Signature of the entities stored in the archetype
+     * @param infos ComponentInfo of every registered component type
+     * @param resource Memory resource the chunks are allocated from
+     */
+    Archetype(Signature signature, const std::array<ComponentInfo, MAX_COMPONENTS>& infos, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : signature(signature)
+        , resource(resource)
+        , chunks(resource)
+        , chunk_size(CHUNK_SIZE)
+        , chunk_capacity(0)
+        , row_count(0)
+    {
+        std::size_t row_size = sizeof(Entity);
+
+        for (std::size_t type = 0; type < MAX_COMPONENTS; type++) {
+            if (signature.test(type)) {
+                columns.push_back(static_cast<ComponentType>(type));
+                this->infos[type] = infos[type];
+                row_size += infos[type].size;
+            }
+        }
+        chunk_capacity = CHUNK_SIZE / row_size;
+        while (chunk_capacity > 1 && layout(chunk_capacity) > CHUNK_SIZE)
+            chunk_capacity--;
+        if (chunk_capacity == 0)
+            chunk_capacity = 1;
+        chunk_size = std::max(CHUNK_SIZE, layout(chunk_capacity));
+    }
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+    ~Archetype()
+    {
+        for (std::size_t row = 0; row < row_count; row++)
+            for (ComponentType type : columns)
+                infos[type].destroy(get(type, row));
+    }
+    /**
+     * @brief Append a row for an entity, its components are left unconstructed
+     * @param entity Entity to append
+     * @return std::size_t Row of the entity
+     */
+    std::size_t push(Entity entity)
+    {
+        if (row_count / chunk_capacity >= chunks.size())
+            chunks.push_back(allocateArray<std::byte>(resource, chunk_size, COLUMN_ALIGNMENT));
+        entities(row_count / chunk_capacity)[row_count % chunk_capacity] = entity;
+        return (row_count++);
+    }
+    /**
+     * @brief Remove the last row without destroying its components, undoing a push whose components were never constructed
+     */
+    void pop()
+    {
+        row_count--;
+        if (chunks.size() > (row_count + chunk_capacity - 1) / chunk_capacity)
+            chunks.pop_back();
+    }
+    /**
+     * @brief Destroy the components of a row and move the last row in its place
+     * @param row Row to remove
+     */
+    void erase(std::size_t row)
+    {
+        std::size_t last = row_count - 1;
+
+        for (ComponentType type : columns)
+            infos[type].destroy(get(type, row));
+        if (row != last) {
+            for (ComponentType type : columns) {
+                infos[type].move(get(type, row), get(type, last));
+                infos[type].destroy(get(type, last));
+            }
+            entities(row / chunk_capacity)[row % chunk_capacity] = entityAt(last);
+        }
+        row_count--;
+        if (chunks.size() > (row_count + chunk_capacity - 1) / chunk_capacity)
+            chunks.pop_back();
+    }
+    /**
+     * @brief Get the address of a component of a row, the archetype must contain the component type
+     * @param type ComponentType of the component
+     * @param row Row of the component
+     * @return void* Address of the component
+     */
+    void* get(ComponentType type, std::size_t row)
+    {
+        return (chunks[row / chunk_capacity].get() + column_offsets[type] + (row % chunk_capacity) * infos[type].size);
+    }
+    /**
+     * @brief Get the entity stored at a row
+     * @param row Row of the entity
+     * @return Entity Entity at this row
+     */
+    Entity entityAt(std::size_t row) const
+    {
+        return (entities(row / chunk_capacity)[row % chunk_capacity]);
+    }
+    /**
+     * @brief Get the entities of a chunk
+     * @param chunk Index of the chunk
+     * @return Entity* Pointer to the first entity of the chunk
+     */
+    Entity* entities(std::size_t chunk) const
+    {
+        return (reinterpret_cast<Entity*>(chunks[chunk].get()));
+    }
+    /**
+     * @brief Get the column of a component type in a chunk
+     * @tparam ComponentT Type of the component, must be part of the archetype
+     * @param type ComponentType of the component
+     * @param chunk Index of the chunk
+     * @return ComponentT* Pointer to the first component of the column
+     */
+    template<typename ComponentT>
+    ComponentT* column(ComponentType type, std::size_t chunk) const
+    {
+        return (std::launder(reinterpret_cast<ComponentT*>(chunks[chunk].get() + column_offsets[type])));
+    }
+    /**
+     * @brief Get the number of rows of a chunk
+     * @param chunk Index of the chunk
+     * @return std::size_t Number of rows
+     */
+    std::size_t chunkRows(std::size_t chunk) const
+    {
+        return (std::min(chunk_capacity, row_count - chunk * chunk_capacity));
+    }
+    /**
+     * @brief Get the number of allocated chunks
+     * @return std::size_t Number of chunks
+     */
+    std::size_t chunkCount() const
+    {
+        return (chunks.size());
+    }
+    /**
+     * @brief Get the number of rows of a chunk when full
+     * @return std::size_t Capacity of a chunk
+     */
+    std::size_t capacity() const
+    {
+        return (chunk_capacity);
+    }
+    /**
+     * @brief Get the number of entities stored in the archetype
+     * @return std::size_t Number of entities
+     */
+    std::size_t size() const
+    {
+        return (row_count);
+    }
+    /**
+     * @brief Get the signature of the archetype
+     * @return Signature Signature of the archetype
+     */
+    Signature getSignature() const
+    {
+        return (signature);
+    }
+    /**
+     * @brief Get the ComponentInfo of a component type of the archetype
+     * @param type ComponentType of the component
+     * @return const ComponentInfo& Info of the component type
+     */
+    const ComponentInfo& getInfo(ComponentType type) const
+    {
+        return (infos[type]);
+    }
+    /**
+     * @brief Get the component types of the archetype
+     * @return const std::vector<ComponentType>& Component types, in ascending order
+     */
+    const std::vector<ComponentType>& getColumns() const
+    {
+        return (columns);
+    }
+
+    /**
+     * @brief Archetype reached by adding a component type, resolved lazily by the ArchetypeManager
+     */
+    std::array<Archetype*, MAX_COMPONENTS> add_edges {};
+    /**
+     * @brief Archetype reached by removing a component type, resolved lazily by the ArchetypeManager
+     */
+    std::array<Archetype*, MAX_COMPONENTS> remove_edges {};
+
+private:
+    Signature signature;
+    std::pmr::memory_resource* resource;
+    std::vector<ComponentType> columns;
+    std::array<ComponentInfo, MAX_COMPONENTS> infos {};
+    std::array<std::size_t, MAX_COMPONENTS> column_offsets {};
+    std::pmr::vector<ResourcePtr<std::byte>> chunks;
+    std::size_t chunk_size;
+    std::size_t chunk_capacity;
+    std::size_t row_count;
+
+    /**
+     * @brief Compute the column offsets for a chunk capacity
+     * @param capacity Number of rows of a chunk
+     * @return std::size_t Number of bytes needed by a chunk
+     */
+    std::size_t layout(std::size_t capacity)
+    {
+        std::size_t offset = capacity * sizeof(Entity);
+
+        for (ComponentType type : columns) {
+            offset = (offset + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+            column_offsets[type] = offset;
+            offset += capacity * infos[type].size;
+        }
+        return (offset);
+    }
+};
+}
@@ -0,0 +1,447 @@
+#pragma once
+
+#include "Archetype.hpp"
+#include "RuntimeException.hpp"
+#include "TypeIndex.hpp"
+#include "Types.hpp"
+#include <memory>
+#include <memory_resource>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief ArchetypeManager stores components grouped by the Signature of their entity
+ *
+ * It exposes the same interface as the ComponentManager and can replace it in a BasicCoordinator.
+ * Adding or removing a component moves the entity to the archetype of its new signature,
+ * following the edges cached on the archetypes so that a transition only hashes a signature once.
+ * References to components are invalidated whenever their entity changes archetype or the last row
+ * of its archetype is moved in place of a removed one. Chunks, records and the archetype index are
+ * allocated from the memory resource given at construction.
+ */
+class ArchetypeManager {
+public:
+    /**
+     * @brief Construct a new ArchetypeManager object
+     * @param resource Memory resource the archetype chunks, the records and the archetype index are allocated from
+     */
+    explicit ArchetypeManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource)
+        , signature_to_archetype(resource)
+        , records(resource)
+        , root(getArchetype(Signature()))
+    {
+    }
+    /**
+     * @brief Register a new component type
+     * @tparam ComponentT Type of the component to register
+     */
+    template<typename ComponentT>
+    void registerComponent()
+    {
+        static_assert(alignof(ComponentT) <= Archetype::COLUMN_ALIGNMENT, "Component alignment is greater than the alignment of archetype columns");
+        std::size_t index = TypeIndex<ComponentFamily>::get<ComponentT>();
+
+        if (index < component_types.size() && component_types[index] != UNREGISTERED)
+            throw RuntimeException("ArchetypeManager::registerComponent", "This Component Type has already been registered");
+        if (next_available_component_type >= MAX_COMPONENTS)
+            throw RuntimeException("ArchetypeManager::registerComponent", "The Maximum number of component types has been reached");
+        if (index >= component_types.size())
+            component_types.resize(index + 1, UNREGISTERED);
+        infos[next_available_component_type] = ComponentInfo::of<ComponentT>();
+        component_types[index] = next_available_component_type++;
+    }
+    /**
+     * @brief Get the ComponentType of a component type
+     * @tparam ComponentT Type of the component to get the ComponentType from
+     * @return ComponentType of the component type
+     */
+    template<typename ComponentT>
+    ComponentType getComponentType()
+    {
+        return (getComponentType(TypeIndex<ComponentFamily>::get<ComponentT>()));
+    }
+    /**
+     * @brief Get the ComponentType of a component type from its TypeIndex
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @return ComponentType of the component type
+     */
+    ComponentType getComponentType(std::size_t type_index)
+    {
+        if (type_index >= component_types.size() || component_types[type_index] == UNREGISTERED)
+            throw RuntimeException("ArchetypeManager::getComponentType", "This Component Type has never been registered");
+        return (component_types[type_index]);
+    }
+    /**
+     * @brief Add a new component to an entity, moving it to the archetype of its new signature
+     * @tparam ComponentT Type of the component to add
+     * @param entity Entity to add the component to
+     * @param component Component to add
+     */
+    template<typename ComponentT>
+    void addComponent(Entity entity, ComponentT component)
+    {
+        addComponent(TypeIndex<ComponentFamily>::get<ComponentT>(), entity, &component);
+    }
+    /**
+     * @brief Construct a new component of an entity directly in the archetype of its new signature
+     *
+     * The component is constructed in its column before the other components of the entity are moved,
+     * so a throwing constructor leaves the entity in its previous archetype.
+     * @tparam ComponentT Type of the component to construct
+     * @tparam Args Types of the arguments of the constructor
+     * @param entity Entity to add the component to
+     * @param args Arguments forwarded to the constructor of the component
+     * @return ComponentT& Reference to the new component
+     */
+    template<typename ComponentT, typename... Args>
+    ComponentT& emplaceComponent(Entity entity, Args&&... args)
+    {
+        void* component = constructComponent(TypeIndex<ComponentFamily>::get<ComponentT>(), entity, [&args...](void* destination) {
+            new (destination) ComponentT(std::forward<Args>(args)...);
+        });
+
+        return (*static_cast<ComponentT*>(component));
+    }
+    /**
+     * @brief Add a component, given by its TypeIndex, to an entity by moving it from type-erased storage
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @param entity Entity to add the component to
+     * @param component Address of the component to move from
+     */
+    void addComponent(std::size_t type_index, Entity entity, void* component)
+    {
+        constructComponent(type_index, entity, [this, type_index, component](void* destination) {
+            infos[component_types[type_index]].move(destination, component);
+        });
+    }
+    /**
+     * @brief Add the same components to several entities
+     *
+     * Entities without components are appended to the archetype of the resulting signature directly,
+     * the others move through the archetypes one component at a time.
+     * @tparam ComponentTs Types of the components to add
+     * @param entities Entities to add the components to
+     * @param count Number of entities
+     * @param components Components copied to every entity
+     */
+    template<typename... ComponentTs>
+    void addComponents(const Entity* entities, std::size_t count, const ComponentTs&... components)
+    {
+        if constexpr (sizeof...(ComponentTs) == 0)
+            return;
+        std::array<ComponentType, sizeof...(ComponentTs)> types { getComponentType<ComponentTs>()... };
+        Signature signature;
+
+        for (ComponentType type : types)
+            signature.set(type);
+        if (signature.count() != types.size())
+            throw RuntimeException("ArchetypeManager::addComponents", "The same Component Type is added twice");
+        Archetype* target = getArchetype(signature);
+
+        for (std::size_t i = 0; i < count; i++) {
+            Record& record = getRecord(entities[i]);
+
+            if (record.archetype) {
+                (addComponent<ComponentTs>(entities[i], components), ...);
+                continue;
+            }
+            std::size_t row = target->push(entities[i]);
+            std::size_t column = 0;
+
+            ((new (target->get(types[column++], row)) ComponentTs(components)), ...);
+            record.archetype = target;
+            record.row = row;
+        }
+    }
+    /**
+     * @brief Remove a component from an entity, moving it to the archetype of its new signature
+     * @tparam ComponentT Type of the component to remove
+     * @param entity Entity to remove the component from
+     */
+    template<typename ComponentT>
+    void removeComponent(Entity entity)
+    {
+        removeComponent(TypeIndex<ComponentFamily>::get<ComponentT>(), entity);
+    }
+    /**
+     * @brief Remove a component, given by its TypeIndex, from an entity
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @param entity Entity to remove the component from
+     */
+    void removeComponent(std::size_t type_index, Entity entity)
+    {
+        ComponentType type = getComponentType(type_index);
+        Record& record = getRecord(entity);
+
+        if (!record.archetype || !record.archetype->getSignature().test(type))
+            throw RuntimeException("ArchetypeManager::removeComponent", "Entity's component is not contained in corresponding Archetype");
+        Archetype* target = record.archetype->remove_edges[type];
+
+        if (!target) {
+            target = getArchetype(Signature(record.archetype->getSignature()).reset(type));
+            record.archetype->remove_edges[type] = target;
+            target->add_edges[type] = record.archetype;
+        }
+        moveEntity(entity, record, target);
+    }
+    /**
+     * @brief Get the component of an entity
+     * @tparam ComponentT Type of the component to get
+     * @param entity Entity to get the component from
+     * @return Component of the entity
+     */
+    template<typename ComponentT>
+    ComponentT& getComponent(Entity entity)
+    {
+        ComponentType type = getComponentType<ComponentT>();
+
+        Record* record = findRecord(entity);
+
+        if (!record || !record->archetype->getSignature().test(type))
+            throw RuntimeException("ArchetypeManager::getComponent", "Entity's component is not contained in corresponding Archetype");
+        return (*std::launder(static_cast<ComponentT*>(record->archetype->get(type, record->row))));
+    }
+    /**
+     * @brief Overwrite the component of an entity as a whole, the archetype backend has no observers
+     * @tparam ComponentT Type of the component to replace
+     * @param entity Entity owning the component
+     * @param component New value of the component
+     */
+    template<typename ComponentT>
+    void replaceComponent(Entity entity, ComponentT component)
+    {
+        getComponent<ComponentT>(entity) = std::move(component);
+    }
+    /**
+     * @brief Check if an entity has a component
+     * @tparam ComponentT Type of the component to check
+     * @param entity Entity to check
+     * @return true if the entity has the component, false otherwise
+     */
+    template<typename ComponentT>
+    bool hasComponent(Entity entity)
+    {
+        ComponentType type = getComponentType<ComponentT>();
+
+        Record* record = findRecord(entity);
+
+        return (record && record->archetype->getSignature().test(type));
+    }
+    /**
+     * @brief Remove the row of a destroyed entity, only its archetype is visited
+     * @param entity Entity destroyed
+     * @param signature Signature of the entity before it was destroyed, unused as its archetype holds it
+     */
+    void entityDestroyed(Entity entity, [[maybe_unused]] Signature signature)
+    {
+        Record* record = findRecord(entity);
+
+        if (!record)
+            return;
+        removeRow(*record->archetype, record->row);
+        record->archetype = nullptr;
+    }
+    /**
+     * @brief Remove the rows of several destroyed entities
+     * @param entities Entities destroyed, without duplicates
+     * @param signatures Signature of each entity before it was destroyed
+     * @param count Number of entities
+     */
+    void entitiesDestroyed(const Entity* entities, const Signature* signatures, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            entityDestroyed(entities[i], signatures[i]);
+    }
+    /**
+     * @brief Call a function on every entity owning a set of components, streaming through the chunks of matching archetypes
+     * @tparam ComponentTs Types of the components the entities must own
+     * @param function Function called with the entity followed by a reference to each of its components, or with the component references only
+     */
+    template<typename... ComponentTs, typename FunctionT>
+    void each(FunctionT&& function)
+    {
+        std::array<ComponentType, sizeof...(ComponentTs)> types { getComponentType<ComponentTs>()... };
+        Signature mask;
+
+        for (ComponentType type : types)
+            mask.set(type);
+        for (auto const& archetype : archetypes) {
+            if ((archetype->getSignature() & mask) != mask)
+                continue;
+            for (std::size_t chunk = 0; chunk < archetype->chunkCount(); chunk++)
+                eachInChunk<ComponentTs...>(*archetype, chunk, types, function, std::index_sequence_for<ComponentTs...>());
+        }
+    }
+
+private:
+    /**
+     * @brief Location of an entity's components
+     */
+    struct Record {
+        Archetype* archetype = nullptr;
+        std::size_t row = 0;
+    };
+
+    static constexpr ComponentType UNREGISTERED = MAX_COMPONENTS;
+
+    std::pmr::memory_resource* resource;
+    std::vector<ComponentType> component_types;
+    std::array<ComponentInfo, MAX_COMPONENTS> infos {};
+    ComponentType next_available_component_type = 0;
+    std::pmr::unordered_map<Signature, Archetype*> signature_to_archetype;
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::pmr::vector<Record> records;
+    Archetype* root;
+
+    /**
+     * @brief Get the record of an entity, growing the records if needed
+     * @param entity Entity to get the record of
+     * @return Record& Record of the entity
+     */
+    Record& getRecord(Entity entity)
+    {
+        std::uint32_t index = entityIndex(entity);
+
+        if (index >= records.size())
+            records.resize(static_cast<std::size_t>(index) + 1);
+        Record& record = records[index];
+
+        if (record.archetype && record.archetype->entityAt(record.row) != entity)
+            throw RuntimeException("ArchetypeManager::getRecord", "Entity passed as argument is stale, its index is used by another entity");
+        return (record);
+    }
+    /**
+     * @brief Find the record of an entity placed in an archetype
+     * @param entity Entity to find the record of
+     * @return Record* Record of the entity, nullptr if the entity owns no component or is stale
+     */
+    Record* findRecord(Entity entity)
+    {
+        std::uint32_t index = entityIndex(entity);
+
+        if (index >= records.size() || !records[index].archetype || records[index].archetype->entityAt(records[index].row) != entity)
+            return (nullptr);
+        return (&records[index]);
+    }
+    /**
+     * @brief Get the archetype of a signature, creating it if needed
+     * @param signature Signature of the archetype
+     * @return Archetype* Archetype of the signature
+     */
+    Archetype* getArchetype(Signature signature)
+    {
+        auto find_result = signature_to_archetype.find(signature);
+
+        if (find_result != signature_to_archetype.end())
+            return (find_result->second);
+        archetypes.push_back(std::make_unique<Archetype>(signature, infos, resource));
+        signature_to_archetype[signature] = archetypes.back().get();
+        return (archetypes.back().get());
+    }
+    /**
+     * @brief Add a component to an entity, constructing it in the archetype of its new signature
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @param entity Entity to add the component to
+     * @param construct Function constructing the component at the address it is given
+     * @return void* Address of the new component
+     */
+    template<typename ConstructT>
+    void* constructComponent(std::size_t type_index, Entity entity, ConstructT&& construct)
+    {
+        ComponentType type = getComponentType(type_index);
+        Record& record = getRecord(entity);
+        Archetype* source = record.archetype ? record.archetype : root;
+
+        if (source->getSignature().test(type))
+            throw RuntimeException("ArchetypeManager::addComponent", "Entity's component already in corresponding Archetype");
+        Archetype* target = source->add_edges[type];
+
+        if (!target) {
+            target = getArchetype(Signature(source->getSignature()).set(type));
+            source->add_edges[type] = target;
+            target->remove_edges[type] = source;
+        }
+        std::size_t row = target->push(entity);
+
+        try {
+            construct(target->get(type, row));
+        } catch (...) {
+            target->pop();
+            throw;
+        }
+        moveRow(record, target, row);
+        return (target->get(type, row));
+    }
+    /**
+     * @brief Move an entity and the components both archetypes share to another archetype
+     * @param entity Entity to move
+     * @param record Record of the entity, updated to the new location
+     * @param target Archetype to move the entity to, the root archetype only drops the entity
+     * @return std::size_t Row of the entity in the target archetype
+     */
+    std::size_t moveEntity(Entity entity, Record& record, Archetype* target)
+    {
+        if (target == root) {
+            removeRow(*record.archetype, record.row);
+            record.archetype = nullptr;
+            return (0);
+        }
+        std::size_t row = target->push(entity);
+
+        moveRow(record, target, row);
+        return (row);
+    }
+    /**
+     * @brief Move the components an entity shares with another archetype into a row already pushed there
+     * @param record Record of the entity, updated to the new location
+     * @param target Archetype the entity moves to
+     * @param row Row of the entity in the target archetype
+     */
+    void moveRow(Record& record, Archetype* target, std::size_t row)
+    {
+        if (record.archetype) {
+            Archetype& source = *record.archetype;
+
+            for (ComponentType type : source.getColumns())
+                if (target->getSignature().test(type))
+                    infos[type].move(target->get(type, row), source.get(type, record.row));
+            removeRow(source, record.row);
+        }
+        record.archetype = target;
+        record.row = row;
+    }
+    /**
+     * @brief Remove a row of an archetype and update the record of the entity moved in its place
+     * @param archetype Archetype to remove the row from
+     * @param row Row to remove
+     */
+    void removeRow(Archetype& archetype, std::size_t row)
+    {
+        archetype.erase(row);
+        if (row < archetype.size())
+            records[entityIndex(archetype.entityAt(row))].row = row;
+    }
+    /**
+     * @brief Call a function on every row of a chunk
+     */
+    template<typename... ComponentTs, typename FunctionT, std::size_t... Is>
+    void eachInChunk(Archetype& archetype, std::size_t chunk, const std::array<ComponentType, sizeof...(ComponentTs)>& types, FunctionT& function, std::index_sequence<Is...>)
+    {
+        Entity* entities = archetype.entities(chunk);
+        std::tuple<ComponentTs*...> columns { archetype.column<ComponentTs>(types[Is], chunk)... };
+        std::size_t rows = archetype.chunkRows(chunk);
+
+        for (std::size_t row = 0; row < rows; row++) {
+            if constexpr (std::is_invocable_v<FunctionT&, Entity, ComponentTs&...>)
+                function(entities[row], std::get<Is>(columns)[row]...);
+            else
+                function(std::get<Is>(columns)[row]...);
+        }
+    }
+};
+}
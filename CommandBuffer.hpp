@@ -0,0 +1,206 @@
+#pragma once
+
+#include "TypeIndex.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+template<typename ComponentManagerT>
+class BasicCoordinator;
+
+/**
+ * @brief Entity created by a CommandBuffer, only turned into a real Entity when the buffer is flushed
+ */
+struct PendingEntity {
+    std::uint32_t index;
+};
+
+/**
+ * @brief CommandBuffer records structural changes to apply later through BasicCoordinator::flush
+ *
+ * Recording never touches the coordinator, so systems can record while iterating over their entities,
+ * and each worker thread can own its own buffer. Components are moved into a linear arena made of
+ * fixed-size blocks that are kept between flushes.
+ */
+class CommandBuffer {
+public:
+    /**
+     * @brief Size in bytes of an arena block
+     */
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+    /**
+     * @brief Alignment of arena blocks, the maximum alignment of a recorded component
+     */
+    static constexpr std::size_t BLOCK_ALIGNMENT = 64;
+
+    CommandBuffer() = default;
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+    CommandBuffer(CommandBuffer&&) = default;
+    CommandBuffer& operator=(CommandBuffer&&) = delete;
+    ~CommandBuffer()
+    {
+        clear();
+    }
+    /**
+     * @brief Record the creation of an entity
+     * @return PendingEntity Handle usable in the other commands of this buffer
+     */
+    PendingEntity createEntity()
+    {
+        return (PendingEntity { pending_entities++ });
+    }
+    /**
+     * @brief Record the destruction of an entity, the other commands on the same entity are dropped
+     * @param entity Entity to destroy
+     */
+    void destroyEntity(Entity entity)
+    {
+        record(CommandType::Destroy, entity, false, 0, nullptr, nullptr);
+    }
+    /**
+     * @brief Record the addition of a component, replacing the component if the entity already owns one
+     * @tparam ComponentT Type of the component to add
+     * @param entity Entity to add the component to
+     * @param component Component to add
+     */
+    template<typename ComponentT>
+    void addComponent(Entity entity, ComponentT component)
+    {
+        recordAdd(entity, false, std::move(component));
+    }
+    /**
+     * @brief Record the addition of a component to an entity created by this buffer
+     * @tparam ComponentT Type of the component to add
+     * @param entity Pending entity to add the component to
+     * @param component Component to add
+     */
+    template<typename ComponentT>
+    void addComponent(PendingEntity entity, ComponentT component)
+    {
+        recordAdd(entity.index, true, std::move(component));
+    }
+    /**
+     * @brief Record the removal of a component, ignored if the entity does not own it when flushed
+     * @tparam ComponentT Type of the component to remove
+     * @param entity Entity to remove the component from
+     */
+    template<typename ComponentT>
+    void removeComponent(Entity entity)
+    {
+        record(CommandType::Remove, entity, false, TypeIndex<ComponentFamily>::get<ComponentT>(), nullptr, nullptr);
+    }
+    /**
+     * @brief Get the number of recorded commands, entity creations excluded
+     * @return std::size_t Number of commands
+     */
+    std::size_t size() const
+    {
+        return (commands.size());
+    }
+    /**
+     * @brief Check if the buffer has nothing to flush
+     * @return true if no command was recorded, false otherwise
+     */
+    bool empty() const
+    {
+        return (commands.empty() && pending_entities == 0);
+    }
+    /**
+     * @brief Drop every recorded command, arena blocks are kept for the next recordings
+     */
+    void clear()
+    {
+        for (Command& command : commands)
+            if (command.destroy)
+                command.destroy(command.component);
+        commands.clear();
+        pending_entities = 0;
+        current_block = 0;
+        block_offset = 0;
+    }
+
+private:
+    template<typename ComponentManagerT>
+    friend class BasicCoordinator;
+
+    enum class CommandType : std::uint8_t {
+        Destroy,
+        Add,
+        Remove,
+    };
+
+    struct Command {
+        CommandType type;
+        bool pending;
+        Entity entity;
+        std::size_t type_index;
+        void* component;
+        void (*destroy)(void* component);
+    };
+
+    struct BlockDeleter {
+        void operator()(std::byte* block) const
+        {
+            ::operator delete(block, std::align_val_t(BLOCK_ALIGNMENT));
+        }
+    };
+
+    std::vector<Command> commands;
+    std::vector<std::unique_ptr<std::byte, BlockDeleter>> blocks;
+    std::vector<std::size_t> block_sizes;
+    std::size_t current_block = 0;
+    std::size_t block_offset = 0;
+    std::uint32_t pending_entities = 0;
+
+    /**
+     * @brief Append a command
+     */
+    void record(CommandType type, Entity entity, bool pending, std::size_t type_index, void* component, void (*destroy)(void*))
+    {
+        commands.push_back(Command { type, pending, entity, type_index, component, destroy });
+    }
+    /**
+     * @brief Move a component into the arena and record its addition
+     */
+    template<typename ComponentT>
+    void recordAdd(Entity entity, bool pending, ComponentT&& component)
+    {
+        static_assert(alignof(ComponentT) <= BLOCK_ALIGNMENT, "Component alignment is greater than the alignment of CommandBuffer blocks");
+        void* storage = allocate(sizeof(ComponentT), alignof(ComponentT));
+
+        new (storage) ComponentT(std::move(component));
+        record(CommandType::Add, entity, pending, TypeIndex<ComponentFamily>::get<ComponentT>(), storage,
+            [](void* component) { static_cast<ComponentT*>(component)->~ComponentT(); });
+    }
+    /**
+     * @brief Bump-allocate memory in the arena, moving to the next block when the current one is full
+     * @param size Size in bytes
+     * @param alignment Alignment in bytes
+     * @return void* Address of the allocation
+     */
+    void* allocate(std::size_t size, std::size_t alignment)
+    {
+        while (true) {
+            if (current_block == blocks.size()) {
+                block_sizes.push_back(std::max(BLOCK_SIZE, size));
+                blocks.emplace_back(static_cast<std::byte*>(::operator new(block_sizes.back(), std::align_val_t(BLOCK_ALIGNMENT))));
+            }
+            std::size_t offset = (block_offset + alignment - 1) / alignment * alignment;
+
+            if (offset + size <= block_sizes[current_block]) {
+                block_offset = offset + size;
+                return (blocks[current_block].get() + offset);
+            }
+            current_block++;
+            block_offset = 0;
+        }
+    }
+};
+}
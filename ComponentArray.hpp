@@ -1,11 +1,38 @@
 #pragma once
 
+#include "Memory.hpp"
+#include "Observer.hpp"
 #include "RuntimeException.hpp"
+#include "Snapshot.hpp"
+#include "SparseSet.hpp"
 #include "Types.hpp"
-#include <array>
-#include <unordered_map>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace ECS {
+/**
+ * @brief Cloneable tells if the pools of a component type can be copied by World::clone and copyFrom
+ *
+ * Trivially copyable components are cloneable. Specialize it to std::true_type for a copyable component
+ * that is not trivially copyable: the copy constructor of a type is only instantiated once it opts in,
+ * since std::is_copy_constructible cannot tell that an aggregate holding a std::vector<std::unique_ptr<T>>
+ * fails to copy.
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+struct Cloneable : std::is_trivially_copyable<ComponentT> {
+};
+
 /**
  * @brief Interface for ComponentArray
  */
@@ -13,52 +40,533 @@ class IComponentArray {
 public:
     virtual ~IComponentArray() = default;
     virtual void entityDestroyed(Entity entity) = 0;
+    /**
+     * @brief Remove the components of several destroyed entities, compacting the array in one pass
+     * @param entities Destroyed entities, without duplicates, those without a component are ignored
+     * @param count Number of entities
+     */
+    virtual void entitiesDestroyed(const Entity* entities, std::size_t count) = 0;
+    /**
+     * @brief Add a component to an entity by moving it from type-erased storage
+     * @param entity Entity to add the component to
+     * @param component Address of the component to move from, must be of the type of the array
+     */
+    virtual void insertMoved(Entity entity, void* component) = 0;
+    virtual void removeData(Entity entity) = 0;
+    /**
+     * @brief Append the entities and components of the array to a snapshot
+     * @param writer Writer of the snapshot
+     * @param type ComponentType of the array, written in the block header
+     */
+    virtual void serialize(SnapshotWriter& writer, ComponentType type) const = 0;
+    /**
+     * @brief Check that a snapshot block can be loaded into the array
+     * @param header Header of the block
+     * @return true if the component size and copy mode match the array, false otherwise
+     */
+    virtual bool accepts(const SnapshotComponentHeader& header) const = 0;
+    /**
+     * @brief Check that the components of a snapshot block can be read, without loading them
+     * @param reader Reader positioned after the entities of the block, moved past the components
+     * @param header Header of the block, accepted by the array
+     */
+    virtual void validate(SnapshotReader& reader, const SnapshotComponentHeader& header) const = 0;
+    /**
+     * @brief Replace the content of the array with a snapshot block
+     * @param reader Reader positioned after the header of the block
+     * @param header Header of the block
+     */
+    virtual void deserialize(SnapshotReader& reader, const SnapshotComponentHeader& header) = 0;
+    /**
+     * @brief Remove every component
+     */
+    virtual void clear() = 0;
+    /**
+     * @brief Replace the content of the array with a copy of another array of the same component type
+     * @param other Array to copy
+     */
+    virtual void copyFrom(const IComponentArray& other) = 0;
+    /**
+     * @brief Check if copyFrom can copy the components of the array
+     * @return true if the component type is Cloneable, false otherwise
+     */
+    virtual bool isCloneable() const = 0;
+    /**
+     * @brief Start recording the tick at which each component is added or changed, and the removals
+     * @param tick Current tick, read whenever a change is recorded
+     */
+    virtual void enableChangeTracking(const std::uint32_t* tick) = 0;
+    /**
+     * @brief Check if the changes of the array are recorded
+     * @return true if change tracking is enabled, false otherwise
+     */
+    virtual bool tracksChanges() const = 0;
+    /**
+     * @brief Append the removals and the components added or changed after a tick to a delta
+     * @param writer Writer of the delta
+     * @param type ComponentType of the array, written in the block header
+     * @param since Tick of the previous delta, only later changes are written
+     */
+    virtual void serializeChanges(SnapshotWriter& writer, ComponentType type, std::uint32_t since) const = 0;
+    /**
+     * @brief Check that a delta block can be applied to the array
+     * @param header Header of the block
+     * @return true if the component size and copy mode match the array, false otherwise
+     */
+    virtual bool accepts(const SnapshotDeltaComponentHeader& header) const = 0;
+    /**
+     * @brief Apply a delta block, removing and upserting components
+     * @param reader Reader positioned after the header of the block
+     * @param header Header of the block
+     * @param added Receives the entities that did not own the component before
+     * @param removed Receives the entities that lost the component
+     */
+    virtual void deserializeChanges(SnapshotReader& reader, const SnapshotDeltaComponentHeader& header, std::vector<Entity>& added, std::vector<Entity>& removed) = 0;
+    /**
+     * @brief Forget the removals recorded up to a tick, once every consumer of deltas went past it
+     * @param tick Last tick to forget
+     */
+    virtual void discardChanges(std::uint32_t tick) = 0;
 };
 
 /**
  * @brief ComponentArray is a container for components of a specific type
+ *
+ * Entities are stored in a SparseSet whose dense array is kept parallel to the component data,
+ * so the component of the entity at position i of the set is at position i of the data.
+ * Component data is stored in fixed-size pages of raw storage allocated as the array grows, a page never
+ * moves so references to components stay valid while their entity keeps its position. Components are
+ * constructed in place and destroyed when removed, so they need neither a default constructor nor
+ * copy operations, only a move constructor for the swap-and-pop removal. Pages, tick pages and the entity
+ * set are allocated from the memory resource given at construction.
+ *
+ * When change tracking is enabled, a page of ticks parallel to each page of components records the
+ * tick of the last insertion, mutable access or markChanged of each component, and removals are logged.
+ *
+ * Construct, destroy and replace events are emitted to the signals of the array when they have listeners.
+ * Loading a snapshot or clearing the array replaces it in bulk without emitting any event.
  * @tparam ComponentT Type of the components
  */
 template<typename ComponentT>
 class ComponentArray : public IComponentArray {
 public:
+    /**
+     * @brief Number of components held by one page of component data
+     */
+    static constexpr std::size_t PAGE_SIZE = 1024;
+
     /**
      * @brief Construct a new ComponentArray object
+     * @param resource Memory resource the pages and the entity set are allocated from
      */
-    ComponentArray()
-        : index_last(0)
+    explicit ComponentArray(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource)
+        , pages(resource)
+        , entities(resource)
+        , tick_pages(resource)
+        , removals(resource)
+    {
+    }
+    ComponentArray(const ComponentArray&) = delete;
+    ComponentArray& operator=(const ComponentArray&) = delete;
+    ~ComponentArray() override
     {
+        destroyAll();
+    }
+    /**
+     * @brief Construct a new component of an entity in place
+     * @tparam Args Types of the arguments of the constructor
+     * @param entity Entity to add the component to
+     * @param args Arguments forwarded to the constructor of the component
+     * @return ComponentT& Reference to the new component, looked up after the listeners ran since a group may move it
+     */
+    template<typename... Args>
+    ComponentT& emplaceData(Entity entity, Args&&... args)
+    {
+        if (entities.contains(entity))
+            throw RuntimeException("ComponentArray::emplaceData", "Entity's component already in corresponding ComponentArray");
+        std::size_t index = entities.size();
+
+        if (index / PAGE_SIZE >= pages.size())
+            addPage();
+        std::construct_at(slot(index), std::forward<Args>(args)...);
+        stamp(index);
+        entities.insert(entity);
+        on_construct.emit(entity);
+        return (*slot(entities.index(entity)));
     }
     /**
      * @brief Add a new component to an entity
      * @param entity Entity to add the component to
-     * @param component Component to add
+     * @param component Component to add, moved into the array
      */
     void insertData(Entity entity, ComponentT component)
     {
-        if (entity_to_index.find(entity) != entity_to_index.end())
-            throw RuntimeException("ComponentArray::insertData", "Entity's component already in corresponding ComponentArray");
-        entity_to_index[entity] = index_last;
-        index_to_entity[index_last] = entity;
-        component_array[index_last] = component;
-        index_last++;
+        emplaceData(entity, std::move(component));
+    }
+    /**
+     * @brief Add the same component to several entities, appending them in one contiguous run
+     * @param entities Entities to add the component to, none of them may already own it
+     * @param count Number of entities
+     * @param component Component copied to every entity
+     */
+    void insertData(const Entity* entities, std::size_t count, const ComponentT& component)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            if (this->entities.contains(entities[i]))
+                throw RuntimeException("ComponentArray::insertData", "Entity's component already in corresponding ComponentArray");
+        std::size_t first = this->entities.size();
+
+        while (pages.size() * PAGE_SIZE < first + count)
+            addPage();
+        this->entities.reserve(first + count);
+        for (std::size_t i = 0; i < count; i++) {
+            std::construct_at(slot(first + i), component);
+            stamp(first + i);
+            this->entities.insert(entities[i]);
+        }
+        if (!on_construct.empty())
+            for (std::size_t i = 0; i < count; i++)
+                on_construct.emit(entities[i]);
+    }
+    /**
+     * @brief Overwrite the component of an entity as a whole, emitting a replace event
+     * @param entity Entity owning the component
+     * @param component New value of the component
+     */
+    void replaceData(Entity entity, ComponentT component)
+    {
+        if (!entities.contains(entity))
+            throw RuntimeException("ComponentArray::replaceData", "Entity's component is not contained in corresponding ComponentArray");
+        std::size_t index = entities.index(entity);
+
+        at(index) = std::move(component);
+        stamp(index);
+        on_replace.emit(entity);
+    }
+    void insertMoved(Entity entity, void* component) override
+    {
+        insertData(entity, std::move(*static_cast<ComponentT*>(component)));
     }
     /**
      * @brief Remove component data from an entity
      * @param entity Entity to remove the data from
      */
-    void removeData(Entity entity)
+    void removeData(Entity entity) override
     {
-        if (entity_to_index.find(entity) == entity_to_index.end())
+        if (!entities.contains(entity))
             throw RuntimeException("ComponentArray::removeData", "Entity's component is not contained in corresponding ComponentArray");
-        std::size_t index_to_delete = entity_to_index[entity];
-        Entity replacing_entity = index_to_entity[index_last - 1];
-        component_array[entity_to_index[entity]] = component_array[index_last - 1];
-        entity_to_index[replacing_entity] = index_to_delete;
-        index_to_entity[index_to_delete] = replacing_entity;
-        entity_to_index.erase(entity);
-        index_to_entity.erase(index_last - 1);
-        index_last--;
+        on_destroy.emit(entity);
+        erase(entity);
+        if (tick_source)
+            removals.push_back(Removal { entity, *tick_source });
+    }
+    /**
+     * @brief Append the entities and components of the array to a snapshot
+     *
+     * The dense entity array and, for trivially copyable components, every page of components are
+     * referenced without copy. Other components go through their Serializer.
+     * @param writer Writer of the snapshot
+     * @param type ComponentType of the array, written in the block header
+     */
+    void serialize(SnapshotWriter& writer, ComponentType type) const override
+    {
+        if constexpr (!std::is_trivially_copyable_v<ComponentT> && !HasSerializer<ComponentT>) {
+            throw RuntimeException("ComponentArray::serialize", "Component type is not trivially copyable and has no Serializer");
+        } else {
+            std::byte* header = writer.write(SnapshotComponentHeader { type, sizeof(ComponentT),
+                static_cast<std::uint32_t>(entities.size()), std::is_trivially_copyable_v<ComponentT>, 0 });
+            std::size_t payload_start = writer.size();
+
+            writer.reference(entities.data(), entities.size() * sizeof(Entity));
+            writer.align();
+            for (std::size_t first = 0; first < entities.size(); first += PAGE_SIZE) {
+                std::size_t count = std::min(PAGE_SIZE, entities.size() - first);
+
+                if constexpr (std::is_trivially_copyable_v<ComponentT>) {
+                    writer.reference(slot(first), count * sizeof(ComponentT));
+                } else {
+                    for (std::size_t index = first; index < first + count; index++)
+                        Serializer<ComponentT>::save(writer, *slot(index));
+                }
+            }
+            writer.align();
+            std::uint64_t payload_size = writer.size() - payload_start;
+
+            std::memcpy(header + offsetof(SnapshotComponentHeader, payload_size), &payload_size, sizeof(payload_size));
+        }
+    }
+    /**
+     * @brief Check that a snapshot block can be loaded into the array
+     * @param header Header of the block
+     * @return true if the component size and copy mode match the array, false otherwise
+     */
+    bool accepts(const SnapshotComponentHeader& header) const override
+    {
+        return (header.component_size == sizeof(ComponentT) && (header.trivially_copyable != 0) == std::is_trivially_copyable_v<ComponentT>);
+    }
+    /**
+     * @brief Check that the components of a snapshot block can be read, without loading them
+     *
+     * Components going through a Serializer are loaded and dropped, so that a block they cannot be read
+     * from is rejected before the array is cleared.
+     * @param reader Reader positioned after the entities of the block, moved past the components
+     * @param header Header of the block, accepted by the array
+     */
+    void validate(SnapshotReader& reader, const SnapshotComponentHeader& header) const override
+    {
+        if constexpr (!std::is_trivially_copyable_v<ComponentT> && !HasSerializer<ComponentT>) {
+            throw RuntimeException("ComponentArray::validate", "Component type is not trivially copyable and has no Serializer");
+        } else if constexpr (std::is_trivially_copyable_v<ComponentT>) {
+            reader.take(std::size_t(header.count) * sizeof(ComponentT));
+        } else {
+            for (std::uint32_t index = 0; index < header.count; index++)
+                Serializer<ComponentT>::load(reader);
+        }
+        reader.align();
+    }
+    /**
+     * @brief Replace the content of the array with a snapshot block
+     *
+     * The entity set is rebuilt from the dense array of the block and the pages are filled with one
+     * copy each for trivially copyable components, without any per-entity insertion.
+     * @param reader Reader positioned after the header of the block
+     * @param header Header of the block, accepted by the array
+     */
+    void deserialize(SnapshotReader& reader, const SnapshotComponentHeader& header) override
+    {
+        if constexpr (!std::is_trivially_copyable_v<ComponentT> && !HasSerializer<ComponentT>) {
+            throw RuntimeException("ComponentArray::deserialize", "Component type is not trivially copyable and has no Serializer");
+        } else {
+            std::size_t count = header.count;
+            const Entity* block_entities = reader.takeArray<Entity>(count);
+
+            reader.align();
+            clear();
+            for (std::size_t first = 0; first < count; first += PAGE_SIZE) {
+                std::size_t page_count = std::min(PAGE_SIZE, count - first);
+
+                pages.push_back(allocatePage());
+                if constexpr (std::is_trivially_copyable_v<ComponentT>) {
+                    reader.read(slot(first), page_count * sizeof(ComponentT));
+                } else {
+                    for (std::size_t index = first; index < first + page_count; index++)
+                        std::construct_at(slot(index), Serializer<ComponentT>::load(reader));
+                }
+                if (tick_source) {
+                    tick_pages.push_back(allocateArray<std::uint32_t>(resource, PAGE_SIZE));
+                    std::fill_n(tick_pages.back().get(), PAGE_SIZE, *tick_source);
+                }
+            }
+            entities.assign(block_entities, count);
+            reader.align();
+        }
+    }
+    /**
+     * @brief Remove every component, the pages are released
+     */
+    void clear() override
+    {
+        destroyAll();
+        entities.clear();
+        pages.clear();
+        tick_pages.clear();
+        removals.clear();
+    }
+    /**
+     * @brief Replace the content of the array with a copy of another array of the same component type
+     *
+     * Trivially copyable components are copied one page at a time with memcpy, other Cloneable
+     * components are copy-constructed. The tick pages are copied when both arrays track changes.
+     * Listeners of the signals are not copied.
+     * @param source Array to copy, a ComponentArray<ComponentT>
+     */
+    void copyFrom(const IComponentArray& source) override
+    {
+        if constexpr (!Cloneable<ComponentT>::value) {
+            throw RuntimeException("ComponentArray::copyFrom", "Component type is not Cloneable, specialize ECS::Cloneable to copy it");
+        } else {
+            const ComponentArray& other = static_cast<const ComponentArray&>(source);
+            std::size_t count = other.entities.size();
+
+            destroyAll();
+            entities.clear();
+            removals.clear();
+            while (pages.size() * PAGE_SIZE < count)
+                addPage();
+            for (std::size_t first = 0; first < count; first += PAGE_SIZE) {
+                if constexpr (std::is_trivially_copyable_v<ComponentT>) {
+                    std::memcpy(slot(first), other.slot(first), std::min(PAGE_SIZE, count - first) * sizeof(ComponentT));
+                } else {
+                    for (std::size_t index = first; index < std::min(first + PAGE_SIZE, count); index++)
+                        std::construct_at(slot(index), *other.slot(index));
+                }
+                if (tick_source && other.tick_source)
+                    std::copy_n(other.tick_pages[first / PAGE_SIZE].get(), PAGE_SIZE, tick_pages[first / PAGE_SIZE].get());
+                else if (tick_source)
+                    std::fill_n(tick_pages[first / PAGE_SIZE].get(), PAGE_SIZE, *tick_source);
+            }
+            entities.copyFrom(other.entities);
+            if (tick_source && other.tick_source)
+                removals.assign(other.removals.begin(), other.removals.end());
+        }
+    }
+    /**
+     * @brief Check if copyFrom can copy the components of the array
+     * @return true if the component type is Cloneable, false otherwise
+     */
+    bool isCloneable() const override
+    {
+        return (Cloneable<ComponentT>::value);
+    }
+    /**
+     * @brief Start recording the tick at which each component is added or changed, and the removals
+     *
+     * Components already in the array are recorded as changed at the current tick.
+     * @param tick Current tick, read whenever a change is recorded, must outlive the array
+     */
+    void enableChangeTracking(const std::uint32_t* tick) override
+    {
+        if (tick_source)
+            return;
+        tick_source = tick;
+        for (std::size_t page = 0; page < pages.size(); page++) {
+            tick_pages.push_back(allocateArray<std::uint32_t>(resource, PAGE_SIZE));
+            std::fill_n(tick_pages.back().get(), PAGE_SIZE, *tick_source);
+        }
+    }
+    /**
+     * @brief Check if the changes of the array are recorded
+     * @return true if change tracking is enabled, false otherwise
+     */
+    bool tracksChanges() const override
+    {
+        return (tick_source != nullptr);
+    }
+    /**
+     * @brief Record that the component of an entity changed at the current tick, without accessing it
+     * @param entity Entity whose component changed
+     */
+    void markChanged(Entity entity)
+    {
+        if (!entities.contains(entity))
+            throw RuntimeException("ComponentArray::markChanged", "Entity's component is not contained in corresponding ComponentArray");
+        stamp(entities.index(entity));
+    }
+    /**
+     * @brief Check if the component at a position of the dense array changed after a tick, change tracking must be enabled
+     * @param index Position of the component
+     * @param since Tick to compare with
+     * @return true if the component was added or changed after the tick, false otherwise
+     */
+    bool changedSince(std::size_t index, std::uint32_t since) const
+    {
+        return (tick_pages[index / PAGE_SIZE][index % PAGE_SIZE] > since);
+    }
+    /**
+     * @brief Append the removals and the components added or changed after a tick to a delta
+     *
+     * The dense tick array is scanned once, changed components are gathered in dense order.
+     * @param writer Writer of the delta
+     * @param type ComponentType of the array, written in the block header
+     * @param since Tick of the previous delta, only later changes are written
+     */
+    void serializeChanges(SnapshotWriter& writer, ComponentType type, std::uint32_t since) const override
+    {
+        if constexpr (!std::is_trivially_copyable_v<ComponentT> && !HasSerializer<ComponentT>) {
+            throw RuntimeException("ComponentArray::serializeChanges", "Component type is not trivially copyable and has no Serializer");
+        } else {
+            if (!tick_source)
+                throw RuntimeException("ComponentArray::serializeChanges", "Changes of this component type are not tracked");
+            std::vector<Entity> removed;
+            std::vector<std::size_t> changed;
+
+            for (const Removal& removal : removals)
+                if (removal.tick > since && !entities.contains(removal.entity))
+                    removed.push_back(removal.entity);
+            std::sort(removed.begin(), removed.end());
+            removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+            for (std::size_t index = 0; index < entities.size(); index++)
+                if (changedSince(index, since))
+                    changed.push_back(index);
+            std::byte* header = writer.write(SnapshotDeltaComponentHeader { type, sizeof(ComponentT), std::is_trivially_copyable_v<ComponentT>,
+                static_cast<std::uint32_t>(removed.size()), static_cast<std::uint32_t>(changed.size()), 0, 0 });
+            std::size_t payload_start = writer.size();
+
+            writer.write(removed.data(), removed.size() * sizeof(Entity));
+            writer.align();
+            for (std::size_t index : changed)
+                writer.write(entities[index]);
+            writer.align();
+            for (std::size_t index : changed) {
+                if constexpr (std::is_trivially_copyable_v<ComponentT>)
+                    writer.write(slot(index), sizeof(ComponentT));
+                else
+                    Serializer<ComponentT>::save(writer, *slot(index));
+            }
+            writer.align();
+            std::uint64_t payload_size = writer.size() - payload_start;
+
+            std::memcpy(header + offsetof(SnapshotDeltaComponentHeader, payload_size), &payload_size, sizeof(payload_size));
+        }
+    }
+    /**
+     * @brief Check that a delta block can be applied to the array
+     * @param header Header of the block
+     * @return true if the component size and copy mode match the array, false otherwise
+     */
+    bool accepts(const SnapshotDeltaComponentHeader& header) const override
+    {
+        return (header.component_size == sizeof(ComponentT) && (header.trivially_copyable != 0) == std::is_trivially_copyable_v<ComponentT>);
+    }
+    /**
+     * @brief Apply a delta block, removing and upserting components
+     * @param reader Reader positioned after the header of the block
+     * @param header Header of the block, accepted by the array
+     * @param added Receives the entities that did not own the component before
+     * @param removed Receives the entities that lost the component
+     */
+    void deserializeChanges(SnapshotReader& reader, const SnapshotDeltaComponentHeader& header, std::vector<Entity>& added, std::vector<Entity>& removed) override
+    {
+        if constexpr (!std::is_trivially_copyable_v<ComponentT> && !HasSerializer<ComponentT>) {
+            throw RuntimeException("ComponentArray::deserializeChanges", "Component type is not trivially copyable and has no Serializer");
+        } else {
+            const Entity* removed_entities = reader.takeArray<Entity>(header.removed_count);
+
+            reader.align();
+            for (std::uint32_t i = 0; i < header.removed_count; i++) {
+                if (entities.contains(removed_entities[i])) {
+                    removeData(removed_entities[i]);
+                    removed.push_back(removed_entities[i]);
+                }
+            }
+            const Entity* changed_entities = reader.takeArray<Entity>(header.changed_count);
+
+            reader.align();
+            for (std::uint32_t i = 0; i < header.changed_count; i++) {
+                ComponentT component = readComponent(reader);
+
+                if (entities.contains(changed_entities[i])) {
+                    std::size_t index = entities.index(changed_entities[i]);
+
+                    at(index) = std::move(component);
+                    stamp(index);
+                    on_replace.emit(changed_entities[i]);
+                } else {
+                    insertData(changed_entities[i], std::move(component));
+                    added.push_back(changed_entities[i]);
+                }
+            }
+            reader.align();
+        }
+    }
+    /**
+     * @brief Forget the removals recorded up to a tick
+     * @param tick Last tick to forget
+     */
+    void discardChanges(std::uint32_t tick) override
+    {
+        std::erase_if(removals, [tick](const Removal& removal) { return (removal.tick <= tick); });
     }
     /**
      * @brief Get the component data of an entity
@@ -67,9 +575,23 @@ public:
      */
     ComponentT& getData(Entity entity)
     {
-        if (entity_to_index.find(entity) == entity_to_index.end())
+        if (!entities.contains(entity))
             throw RuntimeException("ComponentArray::getData", "Entity's component is not contained in corresponding ComponentArray");
-        return (component_array[entity_to_index[entity]]);
+        std::size_t index = entities.index(entity);
+
+        stamp(index);
+        return (at(index));
+    }
+    /**
+     * @brief Get the component data of an entity for reading, not recorded as a change
+     * @param entity Entity to get the data from
+     * @return const ComponentT& Reference to the component
+     */
+    const ComponentT& readData(Entity entity) const
+    {
+        if (!entities.contains(entity))
+            throw RuntimeException("ComponentArray::readData", "Entity's component is not contained in corresponding ComponentArray");
+        return (*slot(entities.index(entity)));
     }
     /**
      * @brief Signals that an entity has been destroyed and removes the component data from the entity if it exists
@@ -77,8 +599,46 @@ public:
      */
     void entityDestroyed(Entity entity) override
     {
-        if (entity_to_index.find(entity) != entity_to_index.end())
-            removeData(entity);
+        if (entities.contains(entity)) {
+            on_destroy.emit(entity);
+            erase(entity);
+        }
+    }
+    /**
+     * @brief Remove the components of several destroyed entities, compacting the array in one pass
+     *
+     * The destroy signal is emitted for every entity first, then the removed components are destroyed
+     * and the holes below the new size filled with the components kept after it.
+     * @param destroyed Destroyed entities, without duplicates, those without a component are ignored
+     * @param count Number of entities
+     */
+    void entitiesDestroyed(const Entity* destroyed, std::size_t count) override
+    {
+        std::vector<std::size_t> positions;
+
+        if (!on_destroy.empty())
+            for (std::size_t i = 0; i < count; i++)
+                if (entities.contains(destroyed[i]))
+                    on_destroy.emit(destroyed[i]);
+        // positions are read after the listeners ran, as groups reorder the array on destroy events
+        positions.reserve(count);
+        for (std::size_t i = 0; i < count; i++)
+            if (entities.contains(destroyed[i]))
+                positions.push_back(entities.index(destroyed[i]));
+        if constexpr (!std::is_trivially_destructible_v<ComponentT>)
+            for (std::size_t position : positions)
+                std::destroy_at(slot(position));
+        entities.erase(std::span<const std::size_t>(positions), [this](std::size_t from, std::size_t to) {
+            std::construct_at(slot(to), std::move(*slot(from)));
+            std::destroy_at(slot(from));
+            if (tick_source)
+                tick_pages[to / PAGE_SIZE][to % PAGE_SIZE] = tick_pages[from / PAGE_SIZE][from % PAGE_SIZE];
+        });
+        while (pages.size() > entities.size() / PAGE_SIZE + 2) {
+            pages.pop_back();
+            if (tick_source)
+                tick_pages.pop_back();
+        }
     }
     /**
      * @brief Check if the component array has an entity
@@ -87,13 +647,222 @@ public:
      */
     bool hasEntity(Entity entity)
     {
-        return (entity_to_index.find(entity) != entity_to_index.end());
+        return (entities.contains(entity));
+    }
+    /**
+     * @brief Get the component at a position of the dense array, without checking the position
+     * @param index Position of the component, the entity at this position is `getEntities()[index]`
+     * @return ComponentT& Reference to the component
+     */
+    ComponentT& at(std::size_t index)
+    {
+        return (*slot(index));
+    }
+    /**
+     * @brief Get the entities owning a component, in the order of the component data
+     * @return const SparseSet& Set of the entities
+     */
+    const SparseSet& getEntities() const
+    {
+        return (entities);
+    }
+    /**
+     * @brief Get the number of components in the array
+     * @return std::size_t Number of components
+     */
+    std::size_t size() const
+    {
+        return (entities.size());
+    }
+    /**
+     * @brief Exchange the positions of two components in the dense array, along with their entities and ticks
+     * @param left Position of the first component
+     * @param right Position of the second component
+     */
+    void swapPositions(std::size_t left, std::size_t right)
+    {
+        if (left == right)
+            return;
+        using std::swap;
+
+        swap(*slot(left), *slot(right));
+        if (tick_source)
+            std::swap(tick_pages[left / PAGE_SIZE][left % PAGE_SIZE], tick_pages[right / PAGE_SIZE][right % PAGE_SIZE]);
+        entities.swapPositions(left, right);
+    }
+    /**
+     * @brief Reorder the leading components of the dense array
+     * @param order Position each component comes from: the component at order[i] moves to i, must be a permutation of 0 to order.size() - 1
+     */
+    void permute(std::vector<std::size_t> order)
+    {
+        // each cycle of the permutation is walked once, placing one component per swap
+        for (std::size_t first = 0; first < order.size(); first++) {
+            std::size_t current = first;
+
+            while (order[current] != first) {
+                std::size_t next = order[current];
+
+                swapPositions(current, next);
+                order[current] = current;
+                current = next;
+            }
+            order[current] = current;
+        }
+    }
+    /**
+     * @brief Sort the components in place, the dense order of the entities follows
+     * @param compare Strict weak ordering of two components
+     * @param count Number of leading components to sort, the whole array by default
+     */
+    template<typename CompareT>
+    void sort(CompareT compare, std::size_t count = std::numeric_limits<std::size_t>::max())
+    {
+        std::vector<std::size_t> order(std::min(count, entities.size()));
+
+        std::iota(order.begin(), order.end(), std::size_t(0));
+        std::sort(order.begin(), order.end(), [this, &compare](std::size_t left, std::size_t right) { return (compare(*slot(left), *slot(right))); });
+        permute(std::move(order));
+    }
+    /**
+     * @brief Sort the components in place by a key computed once per component, the dense order of the entities follows
+     *
+     * Components with equal keys keep their relative order.
+     * @param key Function returning the key of a component, such as a material or a cell index
+     * @param count Number of leading components to sort, the whole array by default
+     */
+    template<typename KeyT>
+    void sortBy(KeyT key, std::size_t count = std::numeric_limits<std::size_t>::max())
+    {
+        std::vector<std::pair<std::invoke_result_t<KeyT&, const ComponentT&>, std::size_t>> keys;
+        std::vector<std::size_t> order;
+
+        count = std::min(count, entities.size());
+        keys.reserve(count);
+        for (std::size_t index = 0; index < count; index++)
+            keys.emplace_back(key(*slot(index)), index);
+        std::sort(keys.begin(), keys.end());
+        order.reserve(count);
+        for (const auto& entry : keys)
+            order.push_back(entry.second);
+        permute(std::move(order));
+    }
+    /**
+     * @brief Get the signal of an event
+     * @param event Event to get the signal of
+     * @return Signal& Signal emitted for this event
+     */
+    Signal& getSignal(ComponentEvent event)
+    {
+        switch (event) {
+        case ComponentEvent::Construct:
+            return (on_construct);
+        case ComponentEvent::Destroy:
+            return (on_destroy);
+        default:
+            return (on_replace);
+        }
     }
 
 private:
-    std::array<ComponentT, MAX_ENTITIES> component_array;
-    std::unordered_map<Entity, std::size_t> entity_to_index;
-    std::unordered_map<std::size_t, Entity> index_to_entity;
-    std::size_t index_last;
+    /**
+     * @brief Removal of the component of an entity, logged when change tracking is enabled
+     */
+    struct Removal {
+        Entity entity;
+        std::uint32_t tick;
+    };
+
+    std::pmr::memory_resource* resource;
+    std::pmr::vector<ResourcePtr<std::byte>> pages;
+    SparseSet entities;
+    const std::uint32_t* tick_source = nullptr;
+    std::pmr::vector<ResourcePtr<std::uint32_t>> tick_pages;
+    std::pmr::vector<Removal> removals;
+    Signal on_construct;
+    Signal on_destroy;
+    Signal on_replace;
+
+    /**
+     * @brief Allocate a page of components, and its page of ticks when change tracking is enabled
+     */
+    void addPage()
+    {
+        pages.push_back(allocatePage());
+        if (tick_source)
+            tick_pages.push_back(allocateArray<std::uint32_t>(resource, PAGE_SIZE));
+    }
+    /**
+     * @brief Record a change of the component at a position at the current tick, when change tracking is enabled
+     * @param index Position of the component
+     */
+    void stamp(std::size_t index)
+    {
+        if (tick_source)
+            tick_pages[index / PAGE_SIZE][index % PAGE_SIZE] = *tick_source;
+    }
+    /**
+     * @brief Remove the component of an entity by moving the last component in its place
+     * @param entity Entity owning the component
+     */
+    void erase(Entity entity)
+    {
+        std::size_t index_to_delete = entities.erase(entity);
+        std::size_t last = entities.size();
+
+        std::destroy_at(slot(index_to_delete));
+        if (index_to_delete != last) {
+            std::construct_at(slot(index_to_delete), std::move(*slot(last)));
+            std::destroy_at(slot(last));
+        }
+        if (tick_source)
+            tick_pages[index_to_delete / PAGE_SIZE][index_to_delete % PAGE_SIZE] = tick_pages[last / PAGE_SIZE][last % PAGE_SIZE];
+        // one spare page is kept so that churn around a page boundary does not reallocate
+        if (pages.size() > entities.size() / PAGE_SIZE + 2) {
+            pages.pop_back();
+            if (tick_source)
+                tick_pages.pop_back();
+        }
+    }
+    /**
+     * @brief Get the address of the storage of the component at a position
+     * @param index Position of the component, its page must be allocated
+     * @return ComponentT* Address of the component, constructed or not
+     */
+    ComponentT* slot(std::size_t index) const
+    {
+        return (std::launder(reinterpret_cast<ComponentT*>(pages[index / PAGE_SIZE].get())) + index % PAGE_SIZE);
+    }
+    /**
+     * @brief Allocate the raw storage of a page of components
+     * @return ResourcePtr<std::byte> Storage of PAGE_SIZE components, none of them constructed
+     */
+    ResourcePtr<std::byte> allocatePage()
+    {
+        return (allocateArray<std::byte>(resource, sizeof(ComponentT) * PAGE_SIZE, alignof(ComponentT)));
+    }
+    /**
+     * @brief Destroy every component, the entity set and the pages are left as they are
+     */
+    void destroyAll()
+    {
+        if constexpr (!std::is_trivially_destructible_v<ComponentT>)
+            for (std::size_t index = 0; index < entities.size(); index++)
+                std::destroy_at(slot(index));
+    }
+    /**
+     * @brief Read a component from a delta
+     */
+    static ComponentT readComponent(SnapshotReader& reader)
+    {
+        if constexpr (std::is_trivially_copyable_v<ComponentT>) {
+            alignas(ComponentT) std::byte component[sizeof(ComponentT)];
+
+            reader.read(component, sizeof(ComponentT));
+            return (*std::launder(reinterpret_cast<ComponentT*>(component)));
+        } else {
+            return (Serializer<ComponentT>::load(reader));
+        }
+    }
 };
 }
@@ -1,16 +1,36 @@
 #pragma once
 
 #include "ComponentArray.hpp"
+#include "Group.hpp"
+#include "SoA.hpp"
+#include "TypeIndex.hpp"
 #include "Types.hpp"
+#include <array>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace ECS {
 /**
  * @brief ComponentManager is a container for ComponentArrays
+ *
+ * ComponentArrays are stored in a vector indexed by the TypeIndex of their component type,
+ * resolving the array of a type is a single vector access. The storage of every array is allocated
+ * from the memory resource given at construction.
  */
 class ComponentManager {
 public:
+    /**
+     * @brief Construct a new ComponentManager object
+     * @param resource Memory resource the component pages and entity sets are allocated from
+     */
+    explicit ComponentManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource)
+    {
+    }
     /**
      * @brief Register a new component type
      * @tparam ComponentT Type of the component to register
@@ -18,12 +38,17 @@ public:
     template<typename ComponentT>
     void registerComponent()
     {
-        const char* type_name = typeid(ComponentT).name();
+        std::size_t index = TypeIndex<ComponentFamily>::get<ComponentT>();
 
-        if (type_name_to_component_type.find(type_name) != type_name_to_component_type.end())
-            throw RuntimeException("ComponentManager::getComponentArray", "This Component Type has already been registered");
-        type_name_to_component_type[type_name] = next_available_component_type++;
-        type_name_to_component_array[type_name] = std::make_shared<ComponentArray<ComponentT>>();
+        if (index < component_arrays.size() && component_arrays[index].array)
+            throw RuntimeException("ComponentManager::registerComponent", "This Component Type has already been registered");
+        if (next_available_component_type >= MAX_COMPONENTS)
+            throw RuntimeException("ComponentManager::registerComponent", "The Maximum number of component types has been reached");
+        if (index >= component_arrays.size())
+            component_arrays.resize(index + 1);
+        component_arrays[index].array = std::make_unique<ComponentArray<ComponentT>>(resource);
+        component_arrays[index].type = next_available_component_type++;
+        arrays_by_type.push_back(component_arrays[index].array.get());
     }
     /**
      * @brief Get the ComponentType of a component type
@@ -33,11 +58,16 @@ public:
     template<typename ComponentT>
     ComponentType getComponentType()
     {
-        const char* type_name = typeid(ComponentT).name();
-
-        if (type_name_to_component_type.find(type_name) == type_name_to_component_type.end())
-            throw RuntimeException("ComponentManager::getComponentArray", "This Component Type has never been registered");
-        return (type_name_to_component_type[type_name]);
+        return (getSlot<ComponentT>().type);
+    }
+    /**
+     * @brief Get the ComponentType of a component type from its TypeIndex
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @return ComponentType of the component type
+     */
+    ComponentType getComponentType(std::size_t type_index)
+    {
+        return (getSlot(type_index).type);
     }
     /**
      * @brief Add a new component to an entity
@@ -48,7 +78,32 @@ public:
     template<typename ComponentT>
     void addComponent(Entity entity, ComponentT component)
     {
-        getComponentArray<ComponentT>()->insertData(entity, component);
+        getComponentArray<ComponentT>()->insertData(entity, std::move(component));
+    }
+    /**
+     * @brief Construct a new component of an entity in place
+     * @tparam ComponentT Type of the component to construct
+     * @tparam Args Types of the arguments of the constructor
+     * @param entity Entity to add the component to
+     * @param args Arguments forwarded to the constructor of the component
+     * @return ComponentT& Reference to the new component
+     */
+    template<typename ComponentT, typename... Args>
+    ComponentT& emplaceComponent(Entity entity, Args&&... args)
+    {
+        return (getComponentArray<ComponentT>()->emplaceData(entity, std::forward<Args>(args)...));
+    }
+    /**
+     * @brief Add the same components to several entities, appending each component type in one contiguous run
+     * @tparam ComponentTs Types of the components to add
+     * @param entities Entities to add the components to
+     * @param count Number of entities
+     * @param components Components copied to every entity
+     */
+    template<typename... ComponentTs>
+    void addComponents(const Entity* entities, std::size_t count, const ComponentTs&... components)
+    {
+        (getComponentArray<ComponentTs>()->insertData(entities, count, components), ...);
     }
     /**
      * @brief Remove a component from an entity
@@ -60,6 +115,25 @@ public:
     {
         getComponentArray<ComponentT>()->removeData(entity);
     }
+    /**
+     * @brief Add a component, given by its TypeIndex, to an entity by moving it from type-erased storage
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @param entity Entity to add the component to
+     * @param component Address of the component to move from
+     */
+    void addComponent(std::size_t type_index, Entity entity, void* component)
+    {
+        getSlot(type_index).array->insertMoved(entity, component);
+    }
+    /**
+     * @brief Remove a component, given by its TypeIndex, from an entity
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @param entity Entity to remove the component from
+     */
+    void removeComponent(std::size_t type_index, Entity entity)
+    {
+        getSlot(type_index).array->removeData(entity);
+    }
     /**
      * @brief Get the component of an entity
      * @tparam ComponentT Type of the component to get
@@ -71,6 +145,172 @@ public:
     {
         return getComponentArray<ComponentT>()->getData(entity);
     }
+    /**
+     * @brief Overwrite the component of an entity as a whole, emitting a replace event
+     * @tparam ComponentT Type of the component to replace
+     * @param entity Entity owning the component
+     * @param component New value of the component
+     */
+    template<typename ComponentT>
+    void replaceComponent(Entity entity, ComponentT component)
+    {
+        getComponentArray<ComponentT>()->replaceData(entity, std::move(component));
+    }
+    /**
+     * @brief Get the signal emitted for an event of a component type
+     * @tparam ComponentT Type of the component
+     * @param event Event to get the signal of
+     * @return Signal& Signal of the event
+     */
+    template<typename ComponentT>
+    Signal& getSignal(ComponentEvent event)
+    {
+        return (getComponentArray<ComponentT>()->getSignal(event));
+    }
+    /**
+     * @brief Check that copyFrom can copy another ComponentManager, without copying it
+     *
+     * Both managers must register the same component types in the same order, and every type must be Cloneable.
+     * @param other ComponentManager to copy
+     */
+    void validateCopy(const ComponentManager& other) const
+    {
+        if (component_arrays.size() != other.component_arrays.size())
+            throw RuntimeException("ComponentManager::validateCopy", "The component types are not registered the same way");
+        for (std::size_t index = 0; index < component_arrays.size(); index++)
+            if (!component_arrays[index].array != !other.component_arrays[index].array || component_arrays[index].type != other.component_arrays[index].type)
+                throw RuntimeException("ComponentManager::validateCopy", "The component types are not registered the same way");
+        for (std::size_t index = 0; index < component_arrays.size(); index++)
+            if (component_arrays[index].array && !component_arrays[index].array->isCloneable())
+                throw RuntimeException("ComponentManager::validateCopy", "A component type is not Cloneable, specialize ECS::Cloneable to copy it");
+    }
+    /**
+     * @brief Replace every component with a copy of the components of another ComponentManager registering the same component types in the same order
+     *
+     * The copy is validated before any array is replaced, so a rejected copy leaves the manager untouched.
+     * @param other ComponentManager to copy, with its current tick
+     */
+    void copyFrom(const ComponentManager& other)
+    {
+        validateCopy(other);
+        for (std::size_t index = 0; index < component_arrays.size(); index++)
+            if (component_arrays[index].array)
+                component_arrays[index].array->copyFrom(*other.component_arrays[index].array);
+        tick = other.tick;
+        refreshGroups();
+    }
+    /**
+     * @brief Get the component of an entity for reading, not recorded as a change
+     * @tparam ComponentT Type of the component to get
+     * @param entity Entity to get the component from
+     * @return const ComponentT& Component of the entity
+     */
+    template<typename ComponentT>
+    const ComponentT& readComponent(Entity entity)
+    {
+        return (getComponentArray<ComponentT>()->readData(entity));
+    }
+    /**
+     * @brief Record that the component of an entity changed at the current tick
+     * @tparam ComponentT Type of the component
+     * @param entity Entity whose component changed
+     */
+    template<typename ComponentT>
+    void markChanged(Entity entity)
+    {
+        getComponentArray<ComponentT>()->markChanged(entity);
+    }
+    /**
+     * @brief Start tracking the changes of a component type
+     * @tparam ComponentT Type of the component
+     */
+    template<typename ComponentT>
+    void enableChangeTracking()
+    {
+        getComponentArray<ComponentT>()->enableChangeTracking(&tick);
+    }
+    /**
+     * @brief Get the current tick, the tick changes are recorded at
+     * @return std::uint32_t Current tick, starting at 1
+     */
+    std::uint32_t getTick() const
+    {
+        return (tick);
+    }
+    /**
+     * @brief Get the address of the current tick, stable for the lifetime of the manager
+     * @return const std::uint32_t* Address of the tick
+     */
+    const std::uint32_t* getTickSource() const
+    {
+        return (&tick);
+    }
+    /**
+     * @brief Move to the next tick
+     * @return std::uint32_t New current tick
+     */
+    std::uint32_t advanceTick()
+    {
+        return (++tick);
+    }
+    /**
+     * @brief Append one block per component type whose changes are tracked to a delta
+     * @param writer Writer of the delta
+     * @param since Tick of the previous delta
+     * @return std::uint32_t Number of blocks appended
+     */
+    std::uint32_t serializeChanges(SnapshotWriter& writer, std::uint32_t since) const
+    {
+        std::uint32_t count = 0;
+
+        for (auto const& slot : component_arrays) {
+            if (!slot.array || !slot.array->tracksChanges())
+                continue;
+            slot.array->serializeChanges(writer, slot.type, since);
+            count++;
+        }
+        return (count);
+    }
+    /**
+     * @brief Check that every block of a delta matches a registered component type, without applying anything
+     * @param reader Reader positioned at the first block, moved past the last one
+     * @param count Number of blocks
+     */
+    void validateChanges(SnapshotReader& reader, std::uint32_t count)
+    {
+        for (std::uint32_t block = 0; block < count; block++) {
+            SnapshotDeltaComponentHeader header = reader.read<SnapshotDeltaComponentHeader>();
+            IComponentArray* array = findArray(header.component_type);
+
+            if (!array || !array->accepts(header))
+                throw RuntimeException("ComponentManager::validateChanges", "The delta holds a component type that is not registered the same way");
+            reader.take(header.payload_size);
+        }
+    }
+    /**
+     * @brief Apply the next block of a delta
+     * @param reader Reader positioned at the block, validated beforehand
+     * @param added Receives the entities that gained the component
+     * @param removed Receives the entities that lost the component
+     * @return ComponentType Type of the component of the block
+     */
+    ComponentType deserializeChanges(SnapshotReader& reader, std::vector<Entity>& added, std::vector<Entity>& removed)
+    {
+        SnapshotDeltaComponentHeader header = reader.read<SnapshotDeltaComponentHeader>();
+
+        findArray(header.component_type)->deserializeChanges(reader, header, added, removed);
+        return (static_cast<ComponentType>(header.component_type));
+    }
+    /**
+     * @brief Forget the removals recorded up to a tick in every array
+     * @param tick Last tick to forget
+     */
+    void discardChanges(std::uint32_t tick)
+    {
+        for (auto const& slot : component_arrays)
+            if (slot.array && slot.array->tracksChanges())
+                slot.array->discardChanges(tick);
+    }
     /**
      * @brief Check if an entity has a component
      * @tparam ComponentT Type of the component to check
@@ -83,33 +323,257 @@ public:
         return (getComponentArray<ComponentT>()->hasEntity(entity));
     }
     /**
-     * @brief Destroy an entity
-     * @param entity Entity to destroy
+     * @brief Remove the components of a destroyed entity, only the arrays of its signature are visited
+     * @param entity Entity destroyed
+     * @param signature Signature of the entity before it was destroyed
      */
-    void entityDestroyed(Entity entity)
+    void entityDestroyed(Entity entity, Signature signature)
     {
-        for (auto const& [_, component_array] : type_name_to_component_array)
-            component_array->entityDestroyed(entity);
+        forEachType(signature, [this, entity](ComponentType type) { arrays_by_type[type]->entityDestroyed(entity); });
     }
+    /**
+     * @brief Remove the components of several destroyed entities, each array owned by one of them is compacted once
+     * @param entities Entities destroyed, without duplicates
+     * @param signatures Signature of each entity before it was destroyed
+     * @param count Number of entities
+     */
+    void entitiesDestroyed(const Entity* entities, const Signature* signatures, std::size_t count)
+    {
+        Signature owned;
+        std::vector<Entity> owners;
 
-private:
-    std::unordered_map<const char*, ComponentType> type_name_to_component_type;
-    std::unordered_map<const char*, std::shared_ptr<IComponentArray>> type_name_to_component_array;
-    ComponentType next_available_component_type;
+        for (std::size_t i = 0; i < count; i++)
+            owned |= signatures[i];
+        owners.reserve(count);
+        forEachType(owned, [&](ComponentType type) {
+            owners.clear();
+            for (std::size_t i = 0; i < count; i++)
+                if (signatures[i].test(type))
+                    owners.push_back(entities[i]);
+            arrays_by_type[type]->entitiesDestroyed(owners.data(), owners.size());
+        });
+    }
+    /**
+     * @brief Append one block per registered component type to a snapshot
+     * @param writer Writer of the snapshot
+     * @return std::uint32_t Number of blocks appended
+     */
+    std::uint32_t serialize(SnapshotWriter& writer) const
+    {
+        std::uint32_t count = 0;
+
+        for (auto const& slot : component_arrays) {
+            if (!slot.array)
+                continue;
+            slot.array->serialize(writer, slot.type);
+            count++;
+        }
+        return (count);
+    }
+    /**
+     * @brief Check that the blocks of a snapshot can be loaded, without loading anything
+     *
+     * Every block must match a registered component type and hold exactly the alive entities whose
+     * signature has the type, once each, followed by as many readable components as its payload size.
+     * @param reader Reader positioned at the first block, moved past the last one
+     * @param count Number of blocks
+     * @param snapshot_entities Entities of the snapshot, validated beforehand
+     */
+    void validate(SnapshotReader& reader, std::uint32_t count, const SnapshotEntities& snapshot_entities)
+    {
+        std::array<std::uint32_t, MAX_COMPONENTS> owners {};
+        Signature blocks;
+        // block that last listed each slot, to find entities listed twice in a block
+        std::vector<std::uint32_t> listed(snapshot_entities.slots.size(), count);
+
+        for (std::uint32_t index = 0; index < snapshot_entities.slots.size(); index++)
+            if (entityIndex(snapshot_entities.slots[index]) == index)
+                forEachType(snapshot_entities.signatures[index], [&owners](ComponentType type) { owners[type]++; });
+        for (std::uint32_t block = 0; block < count; block++) {
+            SnapshotComponentHeader header = reader.read<SnapshotComponentHeader>();
+            IComponentArray* array = findArray(header.component_type);
 
+            if (!array || !array->accepts(header))
+                throw RuntimeException("ComponentManager::validate", "The snapshot holds a component type that is not registered the same way");
+            if (blocks.test(header.component_type))
+                throw RuntimeException("ComponentManager::validate", "The snapshot holds several blocks of a component type");
+            blocks.set(header.component_type);
+            if (header.count != owners[header.component_type])
+                throw RuntimeException("ComponentManager::validate", "A block of the snapshot does not hold every entity owning its component type");
+            std::size_t payload_start = reader.position();
+            const Entity* block_entities = reader.takeArray<Entity>(header.count);
+
+            reader.align();
+            for (std::uint32_t i = 0; i < header.count; i++) {
+                std::uint32_t index = entityIndex(block_entities[i]);
+
+                if (index >= snapshot_entities.slots.size() || snapshot_entities.slots[index] != block_entities[i]
+                    || !snapshot_entities.signatures[index].test(header.component_type) || listed[index] == block)
+                    throw RuntimeException("ComponentManager::validate", "A block of the snapshot holds an entity that does not own its component type");
+                listed[index] = block;
+            }
+            array->validate(reader, header);
+            if (reader.position() - payload_start != header.payload_size)
+                throw RuntimeException("ComponentManager::validate", "A block of the snapshot does not match its payload size");
+        }
+        for (ComponentType type = 0; type < MAX_COMPONENTS; type++)
+            if (owners[type] != 0 && !blocks.test(type))
+                throw RuntimeException("ComponentManager::validate", "The snapshot has no block for a component type its entities own");
+    }
+    /**
+     * @brief Replace the content of every ComponentArray with the blocks of a snapshot, arrays without a block are cleared
+     * @param reader Reader positioned at the first block
+     * @param count Number of blocks, validated beforehand
+     */
+    void deserialize(SnapshotReader& reader, std::uint32_t count)
+    {
+        for (auto const& slot : component_arrays)
+            if (slot.array)
+                slot.array->clear();
+        for (std::uint32_t block = 0; block < count; block++) {
+            SnapshotComponentHeader header = reader.read<SnapshotComponentHeader>();
+
+            findArray(header.component_type)->deserialize(reader, header);
+        }
+        refreshGroups();
+    }
+    /**
+     * @brief Get the group owning a set of component types, creating it on the first call
+     *
+     * Creating the group reorders the owned arrays. A component type can only be owned by one group.
+     * @tparam ComponentTs Types of the components owned by the group
+     * @return Group<ComponentTs...>& Group of the component types, owned by the ComponentManager
+     */
+    template<typename... ComponentTs>
+    Group<ComponentTs...>& group()
+    {
+        std::size_t index = TypeIndex<GroupFamily>::get<Group<ComponentTs...>>();
+
+        if (index < groups.size() && groups[index])
+            return (static_cast<Group<ComponentTs...>&>(*groups[index]));
+        if ((getSlot<ComponentTs>().owned || ...))
+            throw RuntimeException("ComponentManager::group", "A component type is already owned by another group");
+        if (index >= groups.size())
+            groups.resize(index + 1);
+        groups[index] = std::make_unique<Group<ComponentTs...>>(getComponentArray<ComponentTs>()...);
+        ((getSlot<ComponentTs>().owned = true), ...);
+        return (static_cast<Group<ComponentTs...>&>(*groups[index]));
+    }
+    /**
+     * @brief Sort the components of a type, the entities iterated from its array follow the same order
+     * @tparam ComponentT Type of the component, not owned by a group
+     * @param compare Strict weak ordering of two components
+     */
+    template<typename ComponentT, typename CompareT>
+    void sort(CompareT compare)
+    {
+        if (getSlot<ComponentT>().owned)
+            throw RuntimeException("ComponentManager::sort", "This Component Type is owned by a group and is sorted through it");
+        getComponentArray<ComponentT>()->sort(std::move(compare));
+    }
+    /**
+     * @brief Sort the components of a type by a key computed once per component, equal keys keep their order
+     * @tparam ComponentT Type of the component, not owned by a group
+     * @param key Function returning the key of a component
+     */
+    template<typename ComponentT, typename KeyT>
+    void sortBy(KeyT key)
+    {
+        if (getSlot<ComponentT>().owned)
+            throw RuntimeException("ComponentManager::sortBy", "This Component Type is owned by a group and is sorted through it");
+        getComponentArray<ComponentT>()->sortBy(std::move(key));
+    }
+    /**
+     * @brief Move the components of a list of entities to the front of the array of a type, in the order of the list
+     * @tparam ComponentT Type of the component
+     * @param order Entities in the order their components must lead the array, without duplicates
+     * @return true if the array was reordered, false if the type is owned by a group or an entity does not own the component
+     */
+    template<typename ComponentT>
+    bool arrange(std::span<const Entity> order)
+    {
+        ComponentArray<ComponentT>* array = getComponentArray<ComponentT>();
+        const SparseSet& entities = array->getEntities();
+
+        if (getSlot<ComponentT>().owned)
+            return (false);
+        for (Entity entity : order)
+            if (!entities.contains(entity))
+                return (false);
+        for (std::size_t index = 0; index < order.size(); index++)
+            array->swapPositions(entities.index(order[index]), index);
+        return (true);
+    }
+    /**
+     * @brief Rebuild the range of every group after their arrays were replaced as a whole
+     */
+    void refreshGroups()
+    {
+        for (auto const& group : groups)
+            if (group)
+                group->refresh();
+    }
     /**
      * @brief Get the ComponentArray of a component type
      * @tparam ComponentT Type of the component to get the ComponentArray from
-     * @return ComponentArray of the component type
+     * @return ComponentArray of the component type, owned by the ComponentManager
      */
     template<typename ComponentT>
-    std::shared_ptr<ComponentArray<ComponentT>> getComponentArray()
+    ComponentArray<ComponentT>* getComponentArray()
     {
-        const char* type_name = typeid(ComponentT).name();
+        return (static_cast<ComponentArray<ComponentT>*>(getSlot<ComponentT>().array.get()));
+    }
+
+private:
+    /**
+     * @brief ComponentArray of a component type and the ComponentType it was registered as
+     */
+    struct ComponentSlot {
+        std::unique_ptr<IComponentArray> array;
+        ComponentType type = 0;
+        bool owned = false;
+    };
+
+    std::pmr::memory_resource* resource;
+    std::vector<ComponentSlot> component_arrays;
+    std::vector<IComponentArray*> arrays_by_type;
+    // declared after the arrays so that groups disconnect from their signals before the arrays are destroyed
+    std::vector<std::unique_ptr<IGroup>> groups;
+    ComponentType next_available_component_type = 0;
+    std::uint32_t tick = 1;
 
-        if (type_name_to_component_type.find(type_name) == type_name_to_component_type.end())
+    /**
+     * @brief Get the slot of a registered component type
+     * @tparam ComponentT Type of the component to get the slot of
+     * @return ComponentSlot& Slot of the component type
+     */
+    template<typename ComponentT>
+    ComponentSlot& getSlot()
+    {
+        return (getSlot(TypeIndex<ComponentFamily>::get<ComponentT>()));
+    }
+    /**
+     * @brief Find the array registered as a ComponentType
+     * @param type ComponentType to look for
+     * @return IComponentArray* Array of the type, nullptr if no component type was registered as it
+     */
+    IComponentArray* findArray(std::uint32_t type) const
+    {
+        for (auto const& slot : component_arrays)
+            if (slot.array && slot.type == type)
+                return (slot.array.get());
+        return (nullptr);
+    }
+    /**
+     * @brief Get the slot of a registered component type from its TypeIndex
+     * @param type_index TypeIndex of the component type in the ComponentFamily
+     * @return ComponentSlot& Slot of the component type
+     */
+    ComponentSlot& getSlot(std::size_t type_index)
+    {
+        if (type_index >= component_arrays.size() || !component_arrays[type_index].array)
             throw RuntimeException("ComponentManager::getComponentArray", "This Component Type has never been registered");
-        return std::static_pointer_cast<ComponentArray<ComponentT>>(type_name_to_component_array[type_name]);
+        return (component_arrays[type_index]);
     }
 };
 }
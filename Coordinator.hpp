@@ -1,25 +1,48 @@
 #pragma once
 
+#include "ArchetypeManager.hpp"
+#include "CommandBuffer.hpp"
 #include "ComponentManager.hpp"
 #include "EntityManager.hpp"
+#include "Hierarchy.hpp"
+#include "Memory.hpp"
+#include "Parallel.hpp"
+#include "Profiler.hpp"
 #include "ResourceManager.hpp"
+#include "Snapshot.hpp"
+#include "SpatialGrid.hpp"
 #include "SystemManager.hpp"
+#include "View.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace ECS {
 /**
- * @brief Coordinator is the main class of the ECS
+ * @brief BasicCoordinator is the main class of the ECS
+ * @tparam ComponentManagerT Storage of the components, either ComponentManager or ArchetypeManager
  */
-class Coordinator {
+template<typename ComponentManagerT>
+class BasicCoordinator {
 public:
     /**
-     * @brief Construct a new Coordinator object
+     * @brief Construct a new BasicCoordinator object
+     * @param max_entities Maximum number of entities alive at the same time, UNLIMITED_ENTITIES to remove the limit
+     * @param resource Memory resource every manager allocates its storage from, such as a PagePoolResource, must outlive the coordinator
      */
-    Coordinator()
-        : entity_manager(std::make_unique<EntityManager>())
-        , component_manager(std::make_unique<ComponentManager>())
-        , system_manager(std::make_unique<SystemManager>())
-        , resource_manager(std::make_unique<ResourceManager>()) {};
+    explicit BasicCoordinator(std::uint32_t max_entities = MAX_ENTITIES, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : entity_manager(std::make_unique<EntityManager>(max_entities, resource))
+        , component_manager(std::make_unique<ComponentManagerT>(resource))
+        , system_manager(std::make_unique<SystemManager>(resource))
+        , resource_manager(std::make_unique<ResourceManager>(resource))
+        , hierarchy_manager(std::make_unique<HierarchyManager>(resource)) {};
     /**
      * @brief Create a new entity
      * @return Entity created
@@ -29,14 +52,181 @@ public:
         return (entity_manager->createEntity());
     }
     /**
-     * @brief Destroy an entity and alert the managers
+     * @brief Create several entities owning the same components
+     *
+     * Entities are allocated in a block, each component type is appended to its storage in one run
+     * and the systems are updated once for the whole batch.
+     * @tparam ComponentTs Types of the components to add
+     * @param count Number of entities to create
+     * @param components Components copied to every created entity
+     * @return std::vector<Entity> Entities created
+     */
+    template<typename... ComponentTs>
+    std::vector<Entity> createEntities(std::size_t count, const ComponentTs&... components)
+    {
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "createEntities", count));
+        Signature signature;
+
+        (signature.set(getComponentType<ComponentTs>(), true), ...);
+        std::vector<Entity> entities = entity_manager->createEntities(count, signature);
+
+        if constexpr (sizeof...(ComponentTs) > 0) {
+            component_manager->addComponents(entities.data(), count, components...);
+            system_manager->entitiesSignatureChanged(entities.data(), count, Signature(), signature);
+        }
+        return (entities);
+    }
+    /**
+     * @brief Destroy an entity and alert the managers, only the components and systems of its signature are visited
+     *
+     * The descendants of an entity with children are destroyed with it, in one batch.
      * @param entity Entity to destroy
      */
     void destroyEntity(Entity entity)
     {
+        if (hierarchy_manager->contains(entity)) {
+            destroyEntities(std::span<const Entity>(&entity, 1));
+            return;
+        }
+        Signature signature = entity_manager->getSignature(entity);
+
         entity_manager->destroyEntity(entity);
-        component_manager->entityDestroyed(entity);
-        system_manager->entityDestroyed(entity);
+        component_manager->entityDestroyed(entity, signature);
+        system_manager->entityDestroyed(entity, signature);
+    }
+    /**
+     * @brief Destroy several entities, each component storage they own is compacted once for the whole batch
+     *
+     * Every entity is checked before any is destroyed, an entity listed several times is destroyed once.
+     * The descendants of the entities are destroyed in the same batch.
+     * @param entities Entities to destroy
+     */
+    void destroyEntities(std::span<const Entity> entities)
+    {
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "destroyEntities", entities.size()));
+        std::vector<Entity> destroyed;
+        std::vector<Entity> descendants;
+        std::vector<Signature> signatures;
+        auto destroy = [&](Entity entity) {
+            if (!entity_manager->isAlive(entity))
+                return;
+            signatures.push_back(entity_manager->getSignature(entity));
+            destroyed.push_back(entity);
+            entity_manager->destroyEntity(entity);
+        };
+
+        for (Entity entity : entities) {
+            if (!entity_manager->isAlive(entity))
+                throw RuntimeException("Coordinator::destroyEntities", "Entity passed as argument is not alive");
+            if (hierarchy_manager->contains(entity))
+                hierarchy_manager->collectDescendants(entity, descendants);
+        }
+        destroyed.reserve(entities.size() + descendants.size());
+        signatures.reserve(entities.size() + descendants.size());
+        for (Entity entity : entities)
+            destroy(entity);
+        for (Entity entity : descendants)
+            destroy(entity);
+        hierarchy_manager->entitiesDestroyed(destroyed.data(), destroyed.size());
+        component_manager->entitiesDestroyed(destroyed.data(), signatures.data(), destroyed.size());
+        system_manager->entitiesDestroyed(destroyed.data(), signatures.data(), destroyed.size());
+    }
+    /**
+     * @brief Check if an entity is alive
+     * @param entity Entity to check
+     * @return true if the entity was created and not destroyed since, false if it is stale
+     */
+    bool isAlive(Entity entity) const
+    {
+        return (entity_manager->isAlive(entity));
+    }
+    /**
+     * @brief Apply the commands recorded in a CommandBuffer, then clear it
+     * @param buffer Buffer to flush
+     */
+    void flush(CommandBuffer& buffer)
+    {
+        flush(std::span<CommandBuffer>(&buffer, 1));
+    }
+    /**
+     * @brief Apply the commands recorded in several CommandBuffers, typically one per worker thread, then clear them
+     *
+     * Pending entities are created in one block, then the commands of all buffers are sorted by entity,
+     * keeping the order of the buffers and of the recording for a given entity. Each entity has its signature
+     * computed once and the systems notified once, whatever the number of commands targeting it.
+     * Commands targeting an entity that is no longer alive when the buffers are flushed are dropped.
+     * Entities destroyed by the buffers drop their other commands and are destroyed in one batch once the
+     * other commands are applied.
+     * @param buffers Buffers to flush
+     */
+    void flush(std::span<CommandBuffer> buffers)
+    {
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "flush"));
+        struct Entry {
+            Entity entity;
+            std::size_t order;
+            CommandBuffer::Command* command;
+        };
+        std::vector<Entry> entries;
+        std::vector<Entity> destroyed_entities;
+        std::size_t order = 0;
+
+        for (const CommandBuffer& buffer : buffers)
+            for (const CommandBuffer::Command& command : buffer.commands)
+                if (command.pending && command.entity >= buffer.pending_entities)
+                    throw RuntimeException("Coordinator::flush", "A PendingEntity was recorded in another CommandBuffer");
+        for (CommandBuffer& buffer : buffers) {
+            std::vector<Entity> created = entity_manager->createEntities(buffer.pending_entities);
+
+            for (CommandBuffer::Command& command : buffer.commands)
+                entries.push_back(Entry { command.pending ? created[command.entity] : command.entity, order++, &command });
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right) {
+            return (left.entity < right.entity || (left.entity == right.entity && left.order < right.order));
+        });
+        for (std::size_t first = 0; first < entries.size();) {
+            Entity entity = entries[first].entity;
+
+            if (!entity_manager->isAlive(entity)) {
+                while (first < entries.size() && entries[first].entity == entity)
+                    first++;
+                continue;
+            }
+            std::size_t last = first;
+
+            while (last < entries.size() && entries[last].entity == entity)
+                last++;
+            // the destruction removes every component and leaves the systems the entity is part of
+            if (std::any_of(entries.begin() + first, entries.begin() + last, [](const Entry& entry) { return (entry.command->type == CommandBuffer::CommandType::Destroy); })) {
+                destroyed_entities.push_back(entity);
+                first = last;
+                continue;
+            }
+            auto old_signature = entity_manager->getSignature(entity);
+            auto signature = old_signature;
+
+            for (std::size_t current = first; current < last; current++) {
+                CommandBuffer::Command& command = *entries[current].command;
+                ComponentType type = component_manager->getComponentType(command.type_index);
+
+                if (signature.test(type)) {
+                    component_manager->removeComponent(command.type_index, entity);
+                    ECS_PROFILE(system_manager->getProfiler().count(Profiler::Counter::RemoveComponent));
+                }
+                if (command.type == CommandBuffer::CommandType::Add) {
+                    component_manager->addComponent(command.type_index, entity, command.component);
+                    ECS_PROFILE(system_manager->getProfiler().count(Profiler::Counter::AddComponent));
+                }
+                signature.set(type, command.type == CommandBuffer::CommandType::Add);
+            }
+            entity_manager->setSignature(entity, signature);
+            if (signature != old_signature)
+                system_manager->entitySignatureChanged(entity, old_signature, signature);
+            first = last;
+        }
+        destroyEntities(destroyed_entities);
+        for (CommandBuffer& buffer : buffers)
+            buffer.clear();
     }
     /**
      * @brief Register a component type to the component manager
@@ -45,7 +235,7 @@ public:
     template<typename ComponentT>
     void registerComponent()
     {
-        component_manager->registerComponent<ComponentT>();
+        component_manager->template registerComponent<ComponentT>();
     }
     /**
      * @brief Add a component to an entity
@@ -56,11 +246,30 @@ public:
     template<typename ComponentT>
     void addComponent(Entity entity, ComponentT component)
     {
-        component_manager->addComponent(entity, component);
-        auto signature = entity_manager->getSignature(entity);
-        signature.set(component_manager->getComponentType<ComponentT>(), true);
-        entity_manager->setSignature(entity, signature);
-        system_manager->entitySignatureChanged(entity, signature);
+        auto old_signature = entity_manager->getSignature(entity);
+
+        component_manager->addComponent(entity, std::move(component));
+        componentAdded<ComponentT>(entity, old_signature);
+    }
+    /**
+     * @brief Construct a component of an entity in place from constructor arguments
+     *
+     * Move-only and non-default-constructible components are supported, the arguments are forwarded
+     * to the constructor without any intermediate copy.
+     * @tparam ComponentT Type of the component to construct
+     * @tparam Args Types of the arguments of the constructor
+     * @param entity Entity to add the component to
+     * @param args Arguments forwarded to the constructor of the component
+     * @return ComponentT& Reference to the new component
+     */
+    template<typename ComponentT, typename... Args>
+    ComponentT& emplaceComponent(Entity entity, Args&&... args)
+    {
+        static_assert(!isSoA<ComponentT>(), "Components with a SoALayout are added by value and accessed through fields<ComponentT>()");
+        auto old_signature = entity_manager->getSignature(entity);
+        component_manager->template emplaceComponent<ComponentT>(entity, std::forward<Args>(args)...);
+        componentAdded<ComponentT>(entity, old_signature);
+        return (component_manager->template getComponent<ComponentT>(entity));
     }
     /**
      * @brief Remove a component from an entity
@@ -70,11 +279,24 @@ public:
     template<typename ComponentT>
     void removeComponent(Entity entity)
     {
-        component_manager->removeComponent<ComponentT>(entity);
-        auto signature = entity_manager->getSignature(entity);
-        signature.set(component_manager->getComponentType<ComponentT>(), false);
+        auto old_signature = entity_manager->getSignature(entity);
+        component_manager->template removeComponent<ComponentT>(entity);
+        ECS_PROFILE(system_manager->getProfiler().count(Profiler::Counter::RemoveComponent));
+        auto signature = old_signature;
+        signature.set(component_manager->template getComponentType<ComponentT>(), false);
         entity_manager->setSignature(entity, signature);
-        system_manager->entitySignatureChanged(entity, signature);
+        system_manager->entitySignatureChanged(entity, old_signature, signature);
+    }
+    /**
+     * @brief Overwrite a component of an entity as a whole, emitting a replace event to its observers
+     * @tparam ComponentT Type of the component to replace
+     * @param entity Entity owning the component
+     * @param component New value of the component
+     */
+    template<typename ComponentT>
+    void replaceComponent(Entity entity, ComponentT component)
+    {
+        component_manager->replaceComponent(entity, std::move(component));
     }
     /**
      * @brief Get a component from an entity
@@ -85,7 +307,8 @@ public:
     template<typename ComponentT>
     ComponentT& getComponent(Entity entity)
     {
-        return component_manager->getComponent<ComponentT>(entity);
+        static_assert(!isSoA<ComponentT>(), "Components with a SoALayout are accessed through fields<ComponentT>()");
+        return component_manager->template getComponent<ComponentT>(entity);
     }
     /**
      * @brief Check if an entity has a component
@@ -96,7 +319,7 @@ public:
     template<typename ComponentT>
     bool hasComponent(Entity entity)
     {
-        return component_manager->hasComponent<ComponentT>(entity);
+        return component_manager->template hasComponent<ComponentT>(entity);
     }
     /**
      * @brief Get the Component Type object
@@ -106,17 +329,19 @@ public:
     template<typename ComponentT>
     ComponentType getComponentType()
     {
-        return component_manager->getComponentType<ComponentT>();
+        return component_manager->template getComponentType<ComponentT>();
     }
     /**
      * @brief Register a system
      * @tparam SystemT Type of the system to register
+     * @tparam Args Types of the arguments to pass to the system constructor
+     * @param args Arguments to pass to the system constructor
      * @return std::shared_ptr<SystemT> Pointer to the system
      */
-    template<typename SystemT>
-    std::shared_ptr<SystemT> registerSystem()
+    template<typename SystemT, typename... Args>
+    std::shared_ptr<SystemT> registerSystem(Args&&... args)
     {
-        return system_manager->registerSystem<SystemT>();
+        return system_manager->registerSystem<SystemT>(std::forward<Args>(args)...);
     }
     /**
      * @brief Set the signature of a system
@@ -150,6 +375,69 @@ public:
     {
         (system_manager->setSignatureBit<SystemT>(getComponentType<ComponentTs>(), value), ...);
     }
+    /**
+     * @brief Declare the component types a system reads, used to schedule systems concurrently
+     * @tparam SystemT Type of the system
+     * @tparam ComponentTs Types of the components read by the system
+     * @param value Value to set the read bits to
+     */
+    template<typename SystemT, typename... ComponentTs>
+    void setReadBits(bool value = true)
+    {
+        (system_manager->setReadBit<SystemT>(getComponentType<ComponentTs>(), value), ...);
+    }
+    /**
+     * @brief Declare the component types a system writes, used to schedule systems concurrently
+     * @tparam SystemT Type of the system
+     * @tparam ComponentTs Types of the components written by the system
+     * @param value Value to set the write bits to
+     */
+    template<typename SystemT, typename... ComponentTs>
+    void setWriteBits(bool value = true)
+    {
+        (system_manager->setWriteBit<SystemT>(getComponentType<ComponentTs>(), value), ...);
+    }
+    /**
+     * @brief Declare the resource types a system reads, systems only reading a resource can run concurrently
+     * @tparam SystemT Type of the system
+     * @tparam ResourceTs Types of the resources read by the system
+     * @param value Value to set the read bits to
+     */
+    template<typename SystemT, typename... ResourceTs>
+    void setResourceReadBits(bool value = true)
+    {
+        (system_manager->setResourceReadBit<SystemT>(TypeIndex<ResourceFamily>::get<ResourceTs>(), value), ...);
+    }
+    /**
+     * @brief Declare the resource types a system writes, used to schedule systems concurrently
+     * @tparam SystemT Type of the system
+     * @tparam ResourceTs Types of the resources written by the system
+     * @param value Value to set the write bits to
+     */
+    template<typename SystemT, typename... ResourceTs>
+    void setResourceWriteBits(bool value = true)
+    {
+        (system_manager->setResourceWriteBit<SystemT>(TypeIndex<ResourceFamily>::get<ResourceTs>(), value), ...);
+    }
+    /**
+     * @brief Update every system serially, in registration order
+     *
+     * With ECS_ENABLE_PROFILING defined, each update is a profiler frame.
+     */
+    void update()
+    {
+        ECS_PROFILE(Profiler::Frame frame(system_manager->getProfiler()));
+        system_manager->update();
+    }
+    /**
+     * @brief Update every system on a ThreadPool, systems whose declared accesses conflict run in registration order
+     * @param pool ThreadPool to run the systems on
+     */
+    void update(ThreadPool& pool)
+    {
+        ECS_PROFILE(Profiler::Frame frame(system_manager->getProfiler()));
+        system_manager->update(pool);
+    }
     /**
      * @brief Register a resource
      * @tparam SystemT Type of the resource to register
@@ -158,9 +446,9 @@ public:
      * @return std::shared_ptr<ResourceT> Pointer to the resource
      */
     template<typename ResourceT, typename... Args>
-    std::shared_ptr<ResourceT> registerResource(Args... args)
+    std::shared_ptr<ResourceT> registerResource(Args&&... args)
     {
-        return (resource_manager->registerResource<ResourceT>(args...));
+        return (resource_manager->registerResource<ResourceT>(std::forward<Args>(args)...));
     }
     /**
      * @brief Get a resource
@@ -172,6 +460,38 @@ public:
     {
         return (resource_manager->getResource<ResourceT>());
     }
+    /**
+     * @brief Get a reference to a resource, without touching any reference count
+     *
+     * Systems reading a resource from several threads should declare it with setResourceReadBits and use
+     * this accessor, or keep the reference, rather than copying the shared pointer of getResource.
+     * @tparam ResourceT Type of the resource to get, const-qualified for a read-only reference
+     * @return ResourceT& Reference to the resource, valid as long as the coordinator
+     */
+    template<typename ResourceT>
+    ResourceT& resource()
+    {
+        return (resource_manager->resource<ResourceT>());
+    }
+    /**
+     * @brief Register a SpatialGrid resource indexing the entities owning a position component, only available with the ComponentManager
+     *
+     * The grid follows the components added, replaced and removed, and with trackChanges<PositionT>() the
+     * components written since its previous update. Call its update() once per frame before querying it.
+     * copyFrom and loadSnapshot replace the components without notifying anyone, they rebuild the grid.
+     * @tparam PositionT Type of the position component, registered, with x, y and z members or a SpatialTraits specialization
+     * @param cell_size Edge length of a cell, about the radius of the common queries
+     * @return std::shared_ptr<SpatialGrid<PositionT>> Pointer to the grid, also returned by getResource
+     */
+    template<typename PositionT>
+    std::shared_ptr<SpatialGrid<PositionT>> registerSpatialGrid(float cell_size)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Spatial grids are only available with the ComponentManager");
+        auto grid = registerResource<SpatialGrid<PositionT>>(*component_manager->template getComponentArray<PositionT>(), cell_size, component_manager->getTickSource());
+
+        spatial_grids.push_back(grid.get());
+        return (grid);
+    }
     /**
      * @brief Get a system
      * @tparam SystemT Type of the system to get
@@ -182,11 +502,623 @@ public:
     {
         return (system_manager->getSystem<SystemT>());
     }
+    /**
+     * @brief Get a reference to a system, without touching any reference count
+     * @tparam SystemT Type of the system to get
+     * @return SystemT& Reference to the system, valid as long as the coordinator
+     */
+    template<typename SystemT>
+    SystemT& system()
+    {
+        return (system_manager->system<SystemT>());
+    }
+#ifdef ECS_ENABLE_PROFILING
+    /**
+     * @brief Get the profiler recording the frames, system updates and structural changes
+     * @return Profiler& Profiler of the coordinator
+     */
+    Profiler& getProfiler()
+    {
+        return (system_manager->getProfiler());
+    }
+#endif
+    /**
+     * @brief Replace the entities and components with a copy of another coordinator, only available with the ComponentManager
+     *
+     * Both coordinators must register the same component types in the same order and the same systems
+     * with the same signatures, which a World guarantees, and every component type must be Cloneable.
+     * Component pages, entity slots and the entity sets of the systems are copied as a whole, without any
+     * per-entity insertion or system notification.
+     * The hierarchy is copied too. Resources, the state of the systems and the listeners of observers are not copied,
+     * the spatial grids registered on this coordinator are rebuilt from the copied components.
+     * @param other Coordinator to copy
+     */
+    void copyFrom(const BasicCoordinator& other)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Copying a coordinator is only available with the ComponentManager");
+        if (this == &other)
+            return;
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "copyFrom", other.entity_manager->getAliveCount()));
+        component_manager->validateCopy(*other.component_manager);
+        entity_manager->copyFrom(*other.entity_manager);
+        component_manager->copyFrom(*other.component_manager);
+        system_manager->copyEntitiesFrom(*other.system_manager);
+        hierarchy_manager->copyFrom(*other.hierarchy_manager);
+        for (ISpatialGrid* grid : spatial_grids)
+            grid->rebuild();
+    }
+    /**
+     * @brief Save the entities and components to a snapshot file, only available with the ComponentManager
+     *
+     * Every registered component type must be trivially copyable or have a Serializer. Resources,
+     * systems and the hierarchy are not part of the snapshot.
+     * @param path Path of the file, replaced
+     */
+    void saveSnapshot(const std::string& path)
+    {
+        SnapshotWriter writer;
+
+        writeSnapshot(writer);
+        writer.writeTo(path);
+    }
+    /**
+     * @brief Save the entities and components to a snapshot in memory, only available with the ComponentManager
+     * @return std::vector<std::byte> Bytes of the snapshot
+     */
+    std::vector<std::byte> saveSnapshot()
+    {
+        SnapshotWriter writer;
+        std::vector<std::byte> snapshot;
+
+        writeSnapshot(writer);
+        writer.writeTo(snapshot);
+        return (snapshot);
+    }
+    /**
+     * @brief Replace the entities and components with a snapshot file, memory-mapped while it is loaded
+     * @param path Path of the file
+     */
+    void loadSnapshot(const std::string& path)
+    {
+        MappedFile file(path);
+
+        loadSnapshot(file.bytes());
+    }
+    /**
+     * @brief Replace the entities and components with a snapshot
+     *
+     * The component types must be registered in the same order as in the coordinator that saved the
+     * snapshot. The whole snapshot is checked before anything is replaced, so a rejected snapshot leaves
+     * the coordinator untouched. Entities keep their handles and systems are refilled from the signatures,
+     * every entity of the loaded world is a root of the hierarchy. The spatial grids are rebuilt.
+     * @param snapshot Bytes of the snapshot, aligned to SNAPSHOT_ALIGNMENT
+     */
+    void loadSnapshot(std::span<const std::byte> snapshot)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Snapshots are only available with the ComponentManager");
+        SnapshotReader validator(snapshot);
+        SnapshotHeader header = validator.read<SnapshotHeader>();
+
+        if (header.magic != SNAPSHOT_MAGIC || header.byte_order != SNAPSHOT_MAGIC)
+            throw RuntimeException("Coordinator::loadSnapshot", "This is not a snapshot or it was written with another byte order");
+        if (header.version != SNAPSHOT_VERSION)
+            throw RuntimeException("Coordinator::loadSnapshot", "The snapshot was written with another version of the format");
+        SnapshotEntities snapshot_entities = entity_manager->validate(validator);
+
+        component_manager->validate(validator, header.component_count, snapshot_entities);
+        if (!validator.atEnd())
+            throw RuntimeException("Coordinator::loadSnapshot", "The snapshot has trailing data");
+        SnapshotReader reader(snapshot);
+
+        reader.read<SnapshotHeader>();
+        entity_manager->deserialize(reader);
+        component_manager->deserialize(reader, header.component_count);
+        system_manager->clearEntities();
+        hierarchy_manager->clear();
+        entity_manager->each([this](Entity entity, Signature signature) {
+            if (signature.any())
+                system_manager->entitySignatureChanged(entity, Signature(), signature);
+        });
+        for (ISpatialGrid* grid : spatial_grids)
+            grid->rebuild();
+    }
+    /**
+     * @brief Start tracking the changes of a component type, as well as entity creations and destructions, only available with the ComponentManager
+     *
+     * Tracked components record the tick of their last insertion or mutable access and their removals,
+     * which is what encodeDelta relies on.
+     * @tparam ComponentT Type of the component to track
+     */
+    template<typename ComponentT>
+    void trackChanges()
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Change tracking is only available with the ComponentManager");
+        component_manager->template enableChangeTracking<ComponentT>();
+        entity_manager->enableChangeTracking(component_manager->getTickSource());
+    }
+    /**
+     * @brief Get the current tick, the tick changes are recorded at
+     * @return std::uint32_t Current tick
+     */
+    std::uint32_t getTick() const
+    {
+        return (component_manager->getTick());
+    }
+    /**
+     * @brief Move to the next tick, typically once per frame or before encoding a delta
+     * @return std::uint32_t New current tick
+     */
+    std::uint32_t advanceTick()
+    {
+        return (component_manager->advanceTick());
+    }
+    /**
+     * @brief Record that the component of an entity changed, for components written through a view
+     * @tparam ComponentT Type of the component
+     * @param entity Entity whose component changed
+     */
+    template<typename ComponentT>
+    void markChanged(Entity entity)
+    {
+        static_assert(!isSoA<ComponentT>(), "Components with a SoALayout are accessed through fields<ComponentT>()");
+        component_manager->template markChanged<ComponentT>(entity);
+    }
+    /**
+     * @brief Get a component from an entity for reading, without recording a change
+     * @tparam ComponentT Type of the component to get
+     * @param entity Entity to get the component from
+     * @return const ComponentT& Reference to the component
+     */
+    template<typename ComponentT>
+    const ComponentT& readComponent(Entity entity)
+    {
+        static_assert(!isSoA<ComponentT>(), "Components with a SoALayout are accessed through fields<ComponentT>()");
+        return (component_manager->template readComponent<ComponentT>(entity));
+    }
+    /**
+     * @brief Encode the changes made after a tick, to be applied by applyDelta on a copy of the world as it was at that tick
+     *
+     * Only the component types whose changes are tracked are part of the delta. The current tick is
+     * advanced so that later changes are not mistaken for changes of this delta: the value of getTick() read
+     * before the call is the since of the next delta.
+     * @param since Tick of the previous delta, 0 to encode every tracked component
+     * @return std::vector<std::byte> Bytes of the delta
+     */
+    std::vector<std::byte> encodeDelta(std::uint32_t since)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Deltas are only available with the ComponentManager");
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "encodeDelta"));
+        SnapshotWriter writer;
+        std::vector<Entity> created;
+        std::vector<Entity> destroyed;
+        std::vector<std::byte> delta;
+
+        entity_manager->collectChanges(since, created, destroyed);
+        std::byte* header = writer.write(SnapshotDeltaHeader { DELTA_MAGIC, SNAPSHOT_VERSION, SNAPSHOT_MAGIC, since, getTick(),
+            static_cast<std::uint32_t>(created.size()), static_cast<std::uint32_t>(destroyed.size()), 0 });
+
+        writer.reference(created.data(), created.size() * sizeof(Entity));
+        writer.align();
+        writer.reference(destroyed.data(), destroyed.size() * sizeof(Entity));
+        writer.align();
+        std::uint32_t component_count = component_manager->serializeChanges(writer, since);
+
+        std::memcpy(header + offsetof(SnapshotDeltaHeader, component_count), &component_count, sizeof(component_count));
+        writer.writeTo(delta);
+        advanceTick();
+        return (delta);
+    }
+    /**
+     * @brief Apply a delta produced by encodeDelta
+     *
+     * The coordinator must hold the same entities and tracked components as the encoding one did at the
+     * first tick of the delta, with the component types registered in the same order. The whole delta is
+     * checked before anything is applied. Destroyed entities are destroyed, created entities are created
+     * with the same handles, components are removed, added or overwritten and systems are notified.
+     * @param delta Bytes of the delta, aligned to SNAPSHOT_ALIGNMENT
+     */
+    void applyDelta(std::span<const std::byte> delta)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Deltas are only available with the ComponentManager");
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "applyDelta"));
+        SnapshotReader reader(delta);
+        SnapshotDeltaHeader header = reader.read<SnapshotDeltaHeader>();
+
+        if (header.magic != DELTA_MAGIC || header.byte_order != SNAPSHOT_MAGIC)
+            throw RuntimeException("Coordinator::applyDelta", "This is not a delta or it was written with another byte order");
+        if (header.version != SNAPSHOT_VERSION)
+            throw RuntimeException("Coordinator::applyDelta", "The delta was written with another version of the format");
+        const Entity* created = reader.takeArray<Entity>(header.created_count);
+
+        reader.align();
+        const Entity* destroyed = reader.takeArray<Entity>(header.destroyed_count);
+
+        reader.align();
+        std::size_t blocks = reader.position();
+
+        component_manager->validateChanges(reader, header.component_count);
+        if (!reader.atEnd())
+            throw RuntimeException("Coordinator::applyDelta", "The delta has trailing data");
+        std::vector<Entity> alive;
+        std::vector<Entity> released;
+
+        for (std::uint32_t i = 0; i < header.destroyed_count; i++)
+            if (entity_manager->isAlive(destroyed[i]))
+                alive.push_back(destroyed[i]);
+        released = alive;
+        for (Entity entity : alive)
+            if (hierarchy_manager->contains(entity))
+                hierarchy_manager->collectDescendants(entity, released);
+        entity_manager->validateAdopt(std::span<const Entity>(created, header.created_count), released);
+        destroyEntities(alive);
+        entity_manager->adopt(created, header.created_count);
+        SnapshotReader block_reader(delta);
+        std::vector<Entity> added;
+        std::vector<Entity> removed;
+
+        block_reader.take(blocks);
+        for (std::uint32_t block = 0; block < header.component_count; block++) {
+            added.clear();
+            removed.clear();
+            ComponentType type = component_manager->deserializeChanges(block_reader, added, removed);
+
+            for (Entity entity : removed)
+                updateSignatureBit(entity, type, false);
+            for (Entity entity : added)
+                updateSignatureBit(entity, type, true);
+        }
+    }
+    /**
+     * @brief Forget the removals, creations and destructions recorded up to a tick, once every delta covering them is encoded
+     * @param tick Last tick to forget
+     */
+    void discardChanges(std::uint32_t tick)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Change tracking is only available with the ComponentManager");
+        component_manager->discardChanges(tick);
+        entity_manager->discardChanges(tick);
+    }
+    /**
+     * @brief Get the signal emitted when a component type is added to an entity, only available with the ComponentManager
+     * @tparam ComponentT Type of the component
+     * @return Signal& Signal of the event
+     */
+    template<typename ComponentT>
+    Signal& onConstruct()
+    {
+        return (getSignal<ComponentT>(ComponentEvent::Construct));
+    }
+    /**
+     * @brief Get the signal emitted when a component type is removed from an entity or its entity destroyed, only available with the ComponentManager
+     * @tparam ComponentT Type of the component
+     * @return Signal& Signal of the event
+     */
+    template<typename ComponentT>
+    Signal& onDestroy()
+    {
+        return (getSignal<ComponentT>(ComponentEvent::Destroy));
+    }
+    /**
+     * @brief Get the signal emitted when a component is overwritten through replaceComponent, only available with the ComponentManager
+     * @tparam ComponentT Type of the component
+     * @return Signal& Signal of the event
+     */
+    template<typename ComponentT>
+    Signal& onReplace()
+    {
+        return (getSignal<ComponentT>(ComponentEvent::Replace));
+    }
+    /**
+     * @brief Collect in a list the entities an event of a component type happens to
+     *
+     * For construct and replace events, entities losing the component before the list is drained are
+     * dropped from it, so a drained entity still owns the component.
+     * @tparam ComponentT Type of the component
+     * @param list List collecting the entities, typically a member of the system draining it
+     * @param event Event to collect
+     */
+    template<typename ComponentT>
+    void observe(ReactiveList& list, ComponentEvent event)
+    {
+        list.collect(getSignal<ComponentT>(event));
+        if (event != ComponentEvent::Destroy)
+            list.discard(getSignal<ComponentT>(ComponentEvent::Destroy));
+    }
+    /**
+     * @brief Get a view over the entities owning a set of components, only available with the ComponentManager
+     * @tparam ComponentTs Types of the components the entities must own
+     * @return View<Exclude<>, ComponentTs...> View over the entities, narrowed with `without<Ts...>()`
+     */
+    template<typename... ComponentTs>
+    View<Exclude<>, ComponentTs...> view()
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Views are only available with the ComponentManager");
+        return (View<Exclude<>, ComponentTs...>(*component_manager));
+    }
+    /**
+     * @brief Get the field arrays of a component type stored with a SoALayout, only available with the ComponentManager
+     *
+     * The spans of the view cover every component of the type, entities()[i] owning the fields at position i.
+     * With a group owning several such types, the first group.size() positions of their views belong to the
+     * same entities, so kernels can run over the fields of several components in lockstep.
+     * @tparam ComponentT Type of the component, with a SoALayout
+     * @return SoAView<ComponentT> View over the field arrays, invalidated by the next insertion or removal
+     */
+    template<typename ComponentT>
+    SoAView<ComponentT> fields()
+    {
+        static_assert(isSoA<ComponentT>(), "Field arrays are only available for components with a SoALayout, with the ComponentManager");
+        return (component_manager->template getComponentArray<ComponentT>()->fields());
+    }
+    /**
+     * @brief Get the group owning a set of components, only available with the ComponentManager
+     *
+     * The entities owning every component of the group are kept in the same leading range of the owned
+     * arrays, so iterating the group reads each array sequentially. A component type can only be owned by one group.
+     * @tparam ComponentTs Types of the components owned by the group
+     * @return Group<ComponentTs...>& Group of the components
+     */
+    template<typename... ComponentTs>
+    Group<ComponentTs...>& group()
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Groups are only available with the ComponentManager");
+        return (component_manager->template group<ComponentTs...>());
+    }
+    /**
+     * @brief Sort the components of a type, views led by it visit the entities in the same order, only available with the ComponentManager
+     * @tparam ComponentT Type of the component, a type owned by a group is sorted through the group
+     * @param compare Strict weak ordering of two components
+     */
+    template<typename ComponentT, typename CompareT>
+    void sort(CompareT compare)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Sorting is only available with the ComponentManager");
+        component_manager->template sort<ComponentT>(std::move(compare));
+    }
+    /**
+     * @brief Sort the components of a type by a key computed once per component, equal keys keep their order, only available with the ComponentManager
+     * @tparam ComponentT Type of the component, a type owned by a group is sorted through the group
+     * @param key Function returning the key of a component, such as a material or a spatial cell
+     */
+    template<typename ComponentT, typename KeyT>
+    void sortBy(KeyT key)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Sorting is only available with the ComponentManager");
+        component_manager->template sortBy<ComponentT>(std::move(key));
+    }
+    /**
+     * @brief Call a function on every entity owning a set of components
+     * @tparam ComponentTs Types of the components the entities must own
+     * @param function Function called with the entity followed by a reference to each of its components, or with the component references only
+     */
+    template<typename... ComponentTs, typename FunctionT>
+    void each(FunctionT&& function)
+    {
+        if constexpr (std::is_same_v<ComponentManagerT, ComponentManager>)
+            view<ComponentTs...>().each(std::forward<FunctionT>(function));
+        else
+            component_manager->template each<ComponentTs...>(std::forward<FunctionT>(function));
+    }
+    /**
+     * @brief Call a function on every entity owning a set of components, in parallel chunks on a ThreadPool
+     * @tparam ComponentTs Types of the components the entities must own
+     * @param pool ThreadPool running the chunks
+     * @param function Function called with the entity and a reference to each of its components
+     */
+    template<typename... ComponentTs, typename FunctionT>
+    void parallelEach(ThreadPool& pool, FunctionT&& function)
+    {
+        view<ComponentTs...>().parallelEach(pool, std::forward<FunctionT>(function));
+    }
+    /**
+     * @brief Attach an entity to a parent, detaching it from its previous parent
+     *
+     * Destroying an entity destroys its descendants, and propagate updates a parent before its children.
+     * @param child Entity to attach
+     * @param parent New parent of the entity, must not be the entity itself or one of its descendants
+     */
+    void setParent(Entity child, Entity parent)
+    {
+        if (!entity_manager->isAlive(child) || !entity_manager->isAlive(parent))
+            throw RuntimeException("Coordinator::setParent", "Entity passed as argument is not alive");
+        hierarchy_manager->setParent(child, parent);
+    }
+    /**
+     * @brief Detach an entity from its parent, it becomes a root and its descendants stay attached to it
+     * @param child Entity to detach
+     */
+    void removeParent(Entity child)
+    {
+        hierarchy_manager->removeParent(child);
+    }
+    /**
+     * @brief Get the parent of an entity
+     * @param entity Entity to get the parent of
+     * @return Entity Parent of the entity, NULL_ENTITY for a root
+     */
+    Entity getParent(Entity entity) const
+    {
+        return (hierarchy_manager->getParent(entity));
+    }
+    /**
+     * @brief Get the children of an entity
+     * @param entity Entity to get the children of
+     * @return std::vector<Entity> Children of the entity, in the order they were attached
+     */
+    std::vector<Entity> getChildren(Entity entity) const
+    {
+        std::vector<Entity> children;
+
+        hierarchy_manager->eachChild(entity, [&children](Entity child) { children.push_back(child); });
+        return (children);
+    }
+    /**
+     * @brief Update a component of every child from the same component of its parent, parents before children
+     *
+     * Entities are visited in the breadth-first order of the hierarchy. With the ComponentManager, the array
+     * of the component is reordered to follow that order when every entity of the hierarchy owns it and it is
+     * not owned by a group, then the pass reads the array sequentially. Otherwise each entity is looked up and
+     * the children whose parent or themselves do not own the component are skipped. The writes are not
+     * recorded by change tracking.
+     * @tparam ComponentT Type of the component propagated, such as a transform
+     * @param function Function called with the component of the parent and the component of the child
+     */
+    template<typename ComponentT, typename FunctionT>
+    void propagate(FunctionT&& function)
+    {
+        propagateLevels<ComponentT>(function, [](std::size_t begin, std::size_t end, auto&& step) { step(begin, end); });
+    }
+    /**
+     * @brief Update a component of every child from the same component of its parent, one depth of the hierarchy at a time on a ThreadPool
+     *
+     * Children of the same depth are split in chunks run in parallel, a depth starts once the previous one is done.
+     * @tparam ComponentT Type of the component propagated, such as a transform
+     * @param pool ThreadPool running the chunks
+     * @param function Function called with the component of the parent and the component of the child, concurrently for different children
+     */
+    template<typename ComponentT, typename FunctionT>
+    void propagate(ThreadPool& pool, FunctionT&& function)
+    {
+        propagateLevels<ComponentT>(function, [&pool](std::size_t begin, std::size_t end, auto&& step) {
+            parallelFor(pool, end - begin, [begin, &step](std::size_t first, std::size_t last) { step(begin + first, begin + last); });
+        });
+    }
 
 private:
     std::unique_ptr<EntityManager> entity_manager;
-    std::unique_ptr<ComponentManager> component_manager;
+    std::unique_ptr<ComponentManagerT> component_manager;
     std::unique_ptr<SystemManager> system_manager;
     std::unique_ptr<ResourceManager> resource_manager;
+    std::unique_ptr<HierarchyManager> hierarchy_manager;
+    /**
+     * @brief Grids registered by registerSpatialGrid, owned by the resource manager
+     */
+    std::vector<ISpatialGrid*> spatial_grids;
+
+    /**
+     * @brief Check if a component type is stored field by field, which is only the case with the ComponentManager
+     * @tparam ComponentT Type of the component
+     * @return true if the components are stored as a structure of arrays, false otherwise
+     */
+    template<typename ComponentT>
+    static constexpr bool isSoA()
+    {
+        return (std::is_same_v<ComponentManagerT, ComponentManager> && HasSoALayout<ComponentT>);
+    }
+    /**
+     * @brief Update the signature of an entity and the systems after a component was added to it
+     * @tparam ComponentT Type of the component added
+     * @param entity Entity the component was added to
+     * @param old_signature Signature of the entity before the component was added
+     */
+    template<typename ComponentT>
+    void componentAdded(Entity entity, Signature old_signature)
+    {
+        ECS_PROFILE(system_manager->getProfiler().count(Profiler::Counter::AddComponent));
+        auto signature = old_signature;
+
+        signature.set(component_manager->template getComponentType<ComponentT>(), true);
+        entity_manager->setSignature(entity, signature);
+        system_manager->entitySignatureChanged(entity, old_signature, signature);
+    }
+    /**
+     * @brief Run the propagation of a component over every depth of the hierarchy but the roots
+     * @tparam ComponentT Type of the component propagated
+     * @param function Function called with the component of the parent and the component of the child
+     * @param run Function called with the [begin, end) range of a depth in the order and a step to call on sub-ranges of it
+     */
+    template<typename ComponentT, typename FunctionT, typename RunT>
+    void propagateLevels(FunctionT& function, RunT&& run)
+    {
+        static_assert(!isSoA<ComponentT>(), "Components with a SoALayout are accessed through fields<ComponentT>()");
+        const HierarchyOrder& order = hierarchy_manager->getOrder();
+        ECS_PROFILE(Profiler::Scope scope(system_manager->getProfiler(), "propagate", order.entities.size()));
+
+        if constexpr (std::is_same_v<ComponentManagerT, ComponentManager>) {
+            ComponentArray<ComponentT>* array = component_manager->template getComponentArray<ComponentT>();
+            const SparseSet& entities = array->getEntities();
+            bool ordered = entities.size() >= order.entities.size() && std::equal(order.entities.begin(), order.entities.end(), entities.begin());
+
+            if (ordered || component_manager->template arrange<ComponentT>(order.entities)) {
+                for (std::size_t level = 1; level + 1 < order.levels.size(); level++) {
+                    run(order.levels[level], order.levels[level + 1], [array, &order, &function](std::size_t begin, std::size_t end) {
+                        for (std::size_t position = begin; position < end; position++)
+                            function(std::as_const(array->at(order.parents[position])), array->at(position));
+                    });
+                }
+                return;
+            }
+            for (std::size_t level = 1; level + 1 < order.levels.size(); level++) {
+                run(order.levels[level], order.levels[level + 1], [array, &entities, &order, &function](std::size_t begin, std::size_t end) {
+                    for (std::size_t position = begin; position < end; position++) {
+                        Entity entity = order.entities[position];
+                        Entity parent = order.entities[order.parents[position]];
+
+                        if (entities.contains(entity) && entities.contains(parent))
+                            function(std::as_const(array->at(entities.index(parent))), array->at(entities.index(entity)));
+                    }
+                });
+            }
+        } else {
+            for (std::size_t level = 1; level + 1 < order.levels.size(); level++) {
+                run(order.levels[level], order.levels[level + 1], [this, &order, &function](std::size_t begin, std::size_t end) {
+                    for (std::size_t position = begin; position < end; position++) {
+                        Entity entity = order.entities[position];
+                        Entity parent = order.entities[order.parents[position]];
+
+                        if (component_manager->template hasComponent<ComponentT>(entity) && component_manager->template hasComponent<ComponentT>(parent))
+                            function(std::as_const(component_manager->template getComponent<ComponentT>(parent)), component_manager->template getComponent<ComponentT>(entity));
+                    }
+                });
+            }
+        }
+    }
+    /**
+     * @brief Append the header, the entities and the component blocks of a snapshot
+     * @param writer Writer of the snapshot
+     */
+    void writeSnapshot(SnapshotWriter& writer)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Snapshots are only available with the ComponentManager");
+        std::byte* header = writer.write(SnapshotHeader { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, SNAPSHOT_MAGIC, 0 });
+
+        entity_manager->serialize(writer);
+        std::uint32_t component_count = component_manager->serialize(writer);
+
+        std::memcpy(header + offsetof(SnapshotHeader, component_count), &component_count, sizeof(component_count));
+    }
+    /**
+     * @brief Get the signal of an event of a component type
+     */
+    template<typename ComponentT>
+    Signal& getSignal(ComponentEvent event)
+    {
+        static_assert(std::is_same_v<ComponentManagerT, ComponentManager>, "Observers are only available with the ComponentManager");
+        return (component_manager->template getSignal<ComponentT>(event));
+    }
+    /**
+     * @brief Set or clear the bit of a component type in the signature of an entity and notify the systems
+     * @param entity Entity to update
+     * @param type ComponentType of the bit
+     * @param value Value of the bit
+     */
+    void updateSignatureBit(Entity entity, ComponentType type, bool value)
+    {
+        Signature old_signature = entity_manager->getSignature(entity);
+        Signature signature = old_signature;
+
+        signature.set(type, value);
+        entity_manager->setSignature(entity, signature);
+        system_manager->entitySignatureChanged(entity, old_signature, signature);
+    }
 };
+
+/**
+ * @brief Coordinator storing each component type in its own ComponentArray
+ */
+using Coordinator = BasicCoordinator<ComponentManager>;
+/**
+ * @brief Coordinator storing entities of the same Signature together in archetype chunks
+ */
+using ArchetypeCoordinator = BasicCoordinator<ArchetypeManager>;
 }
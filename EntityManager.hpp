@@ -1,26 +1,41 @@
 #pragma once
 
-#include <array>
-#include <cassert>
-#include <iostream>
-#include <queue>
+#include <algorithm>
+#include <memory_resource>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 #include "RuntimeException.hpp"
+#include "Snapshot.hpp"
 #include "Types.hpp"
 
 namespace ECS {
 /**
  * @brief EntityManager is a container for entities
+ *
+ * Every slot holds the current handle of its entity. Free slots are chained into a free list through
+ * the index part of their handle while their version part already holds the version of the next entity
+ * to use the slot, so destroyed handles never compare equal to a live one until the version wraps around.
  */
 class EntityManager {
 public:
+    /**
+     * @brief Highest number of entities the index part of an Entity can address, one index is kept as the end of the free list
+     */
+    static constexpr std::uint32_t ENTITY_CAPACITY = ENTITY_INDEX_MASK;
+
     /**
      * @brief Construct a new EntityManager object
+     * @param max_entities Maximum number of entities alive at the same time, UNLIMITED_ENTITIES to only be bound by ENTITY_CAPACITY
+     * @param resource Memory resource the entity slots and signatures are allocated from
      */
-    EntityManager()
+    explicit EntityManager(std::uint32_t max_entities = MAX_ENTITIES, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : max_entities(std::min(max_entities, ENTITY_CAPACITY))
+        , entities(resource)
+        , signatures(resource)
+        , changes(resource)
     {
-        for (Entity entity = 0; entity < MAX_ENTITIES; entity++)
-            available_entities.push(entity);
     }
     /**
      * @brief Create a new entity
@@ -28,12 +43,56 @@ public:
      */
     Entity createEntity()
     {
-        if (available_entities.empty())
-            throw RuntimeException("EntityManager::createEntity", "Queue of available entity is empty, meaning that the Maximum number of entity has been reached");
+        if (alive_count >= max_entities)
+            throw RuntimeException("EntityManager::createEntity", "The Maximum number of entity has been reached");
+        alive_count++;
+        if (free_list != FREE_LIST_END) {
+            std::uint32_t index = free_list;
 
-        Entity entity = available_entities.front();
-        available_entities.pop();
-        return (entity);
+            free_list = entityIndex(entities[index]);
+            entities[index] = makeEntity(index, entityVersion(entities[index]));
+            logChange(entities[index], true);
+            return (entities[index]);
+        }
+        entities.push_back(makeEntity(static_cast<std::uint32_t>(entities.size()), 0));
+        signatures.emplace_back();
+        logChange(entities.back(), true);
+        return (entities.back());
+    }
+    /**
+     * @brief Create several entities at once, taking recycled entities first then a contiguous block of new ones
+     * @param count Number of entities to create
+     * @param signature Signature given to every created entity
+     * @return std::vector<Entity> Entities created
+     */
+    std::vector<Entity> createEntities(std::size_t count, Signature signature = Signature())
+    {
+        if (count > max_entities - alive_count)
+            throw RuntimeException("EntityManager::createEntities", "Not enough available entities, the Maximum number of entity would be exceeded");
+        std::vector<Entity> created;
+
+        created.reserve(count);
+        alive_count += static_cast<std::uint32_t>(count);
+        while (free_list != FREE_LIST_END && created.size() < count) {
+            std::uint32_t index = free_list;
+
+            free_list = entityIndex(entities[index]);
+            entities[index] = makeEntity(index, entityVersion(entities[index]));
+            signatures[index] = signature;
+            created.push_back(entities[index]);
+        }
+        std::size_t first = entities.size();
+
+        entities.resize(first + (count - created.size()));
+        signatures.resize(entities.size(), signature);
+        for (std::size_t index = first; index < entities.size(); index++) {
+            entities[index] = makeEntity(static_cast<std::uint32_t>(index), 0);
+            created.push_back(entities[index]);
+        }
+        if (tick_source)
+            for (Entity entity : created)
+                logChange(entity, true);
+        return (created);
     }
     /**
      * @brief Destroy an entity
@@ -41,40 +100,306 @@ public:
      */
     void destroyEntity(Entity entity)
     {
-        if (entity >= MAX_ENTITIES)
-            throw RuntimeException("EntityManager::destroyEntity", "Entity passed as argument cannot exist (>= MAX_ENTITIES)");
+        if (!isAlive(entity))
+            throw RuntimeException("EntityManager::destroyEntity", "Entity passed as argument is not alive");
+        std::uint32_t index = entityIndex(entity);
 
-        signatures[entity].reset();
-        available_entities.push(entity);
+        signatures[index].reset();
+        entities[index] = makeEntity(free_list, entityVersion(entity) + 1);
+        free_list = index;
+        alive_count--;
+        logChange(entity, false);
+    }
+    /**
+     * @brief Check if an entity is alive
+     * @param entity Entity to check
+     * @return true if the entity was created and not destroyed since, false otherwise
+     */
+    bool isAlive(Entity entity) const
+    {
+        return (entityIndex(entity) < entities.size() && entities[entityIndex(entity)] == entity);
     }
     /**
      * @brief Set the signature of an entity
      * @param entity Entity to set the signature of
-     * @return true if the entity is alive, false otherwise
      */
     void setSignature(Entity entity, Signature signature)
     {
-        if (entity >= MAX_ENTITIES)
-            throw RuntimeException("EntityManager::destroyEntity", "Entity passed as argument cannot exist (>= MAX_ENTITIES)");
+        if (!isAlive(entity))
+            throw RuntimeException("EntityManager::setSignature", "Entity passed as argument is not alive");
 
-        signatures[entity] = signature;
+        signatures[entityIndex(entity)] = signature;
     }
     /**
      * @brief Get the signature of an entity
      * @param entity Entity to get the signature of
-     * @return true if the entity is alive, false otherwise
+     * @return Signature of the entity
      */
     Signature getSignature(Entity entity)
     {
-        if (entity >= MAX_ENTITIES)
-            throw RuntimeException("EntityManager::destroyEntity", "Entity passed as argument cannot exist (>= MAX_ENTITIES)");
+        if (!isAlive(entity))
+            throw RuntimeException("EntityManager::getSignature", "Entity passed as argument is not alive");
+
+        return (signatures[entityIndex(entity)]);
+    }
+    /**
+     * @brief Call a function on every entity alive, in index order
+     * @param function Function called with the entity and its signature
+     */
+    template<typename FunctionT>
+    void each(FunctionT&& function) const
+    {
+        for (std::size_t index = 0; index < entities.size(); index++)
+            if (entityIndex(entities[index]) == index)
+                function(entities[index], signatures[index]);
+    }
+    /**
+     * @brief Append the entity slots and signatures to a snapshot, both arrays are referenced without copy
+     * @param writer Writer of the snapshot
+     */
+    void serialize(SnapshotWriter& writer) const
+    {
+        static_assert(std::is_trivially_copyable_v<Signature>, "Signatures are copied as raw bytes");
+        writer.write(SnapshotEntityHeader { static_cast<std::uint32_t>(entities.size()), free_list, alive_count, sizeof(Signature) });
+        writer.reference(entities.data(), entities.size() * sizeof(Entity));
+        writer.align();
+        writer.reference(signatures.data(), signatures.size() * sizeof(Signature));
+        writer.align();
+    }
+    /**
+     * @brief Check that the entities of a snapshot can be loaded, without loading them
+     *
+     * The slots must describe a consistent world: the alive slots hold their own index, and the free
+     * list starts at a free slot and chains every free slot exactly once.
+     * @param reader Reader positioned at the entities, moved past them
+     * @return SnapshotEntities Slots and signatures of the snapshot, in the snapshot itself
+     */
+    SnapshotEntities validate(SnapshotReader& reader) const
+    {
+        SnapshotEntityHeader header = reader.read<SnapshotEntityHeader>();
+
+        if (header.signature_size != sizeof(Signature))
+            throw RuntimeException("EntityManager::validate", "The snapshot was written with another Signature layout");
+        if (header.alive_count > max_entities)
+            throw RuntimeException("EntityManager::validate", "The snapshot holds more entities than the Maximum number of entity");
+        if (header.slot_count > ENTITY_CAPACITY)
+            throw RuntimeException("EntityManager::validate", "The snapshot holds more slots than an Entity can address");
+        const Entity* slots = reader.takeArray<Entity>(header.slot_count);
+        std::uint32_t alive = 0;
+
+        reader.align();
+        const Signature* signatures = reader.takeArray<Signature>(header.slot_count);
+
+        reader.align();
+        for (std::uint32_t index = 0; index < header.slot_count; index++)
+            if (entityIndex(slots[index]) == index)
+                alive++;
+        if (alive != header.alive_count)
+            throw RuntimeException("EntityManager::validate", "The alive count of the snapshot does not match its slots");
+        // a free list visiting more slots than there are free slots loops
+        std::uint32_t free_count = 0;
+
+        for (std::uint32_t index = header.free_list; index != FREE_LIST_END; index = entityIndex(slots[index])) {
+            if (index >= header.slot_count || entityIndex(slots[index]) == index || ++free_count > header.slot_count - alive)
+                throw RuntimeException("EntityManager::validate", "The free list of the snapshot is corrupted");
+        }
+        if (free_count != header.slot_count - alive)
+            throw RuntimeException("EntityManager::validate", "The free list of the snapshot does not chain every free slot");
+        return (SnapshotEntities { std::span<const Entity>(slots, header.slot_count), std::span<const Signature>(signatures, header.slot_count) });
+    }
+    /**
+     * @brief Check that entities can be adopted once some entities are destroyed, without changing anything
+     * @param adopted Entities adopt will make alive
+     * @param released Entities destroyed before the adoption, their slots can be reused
+     */
+    void validateAdopt(std::span<const Entity> adopted, std::span<const Entity> released) const
+    {
+        std::vector<std::uint32_t> freed;
+        std::vector<std::uint32_t> indices;
+
+        for (Entity entity : released)
+            if (isAlive(entity))
+                freed.push_back(entityIndex(entity));
+        std::sort(freed.begin(), freed.end());
+        freed.erase(std::unique(freed.begin(), freed.end()), freed.end());
+        if (adopted.size() > max_entities - (alive_count - freed.size()))
+            throw RuntimeException("EntityManager::validateAdopt", "Not enough available entities, the Maximum number of entity would be exceeded");
+        for (Entity entity : adopted) {
+            std::uint32_t index = entityIndex(entity);
+
+            if (index >= ENTITY_CAPACITY)
+                throw RuntimeException("EntityManager::validateAdopt", "An adopted entity has an index past the capacity");
+            if (index < entities.size() && entityIndex(entities[index]) == index && !std::binary_search(freed.begin(), freed.end(), index))
+                throw RuntimeException("EntityManager::validateAdopt", "The slot of an adopted entity is already used by a live entity");
+            indices.push_back(index);
+        }
+        std::sort(indices.begin(), indices.end());
+        if (std::adjacent_find(indices.begin(), indices.end()) != indices.end())
+            throw RuntimeException("EntityManager::validateAdopt", "Several adopted entities share a slot");
+    }
+    /**
+     * @brief Replace every entity with the entities of a snapshot, keeping their handles and the order of recycling
+     * @param reader Reader positioned at the entities, validated beforehand
+     */
+    void deserialize(SnapshotReader& reader)
+    {
+        SnapshotEntityHeader header = reader.read<SnapshotEntityHeader>();
+        const Entity* slots = reader.takeArray<Entity>(header.slot_count);
 
-        return (signatures[entity]);
+        entities.assign(slots, slots + header.slot_count);
+        reader.align();
+        const Signature* slot_signatures = reader.takeArray<Signature>(header.slot_count);
+
+        signatures.assign(slot_signatures, slot_signatures + header.slot_count);
+        reader.align();
+        free_list = header.free_list;
+        alive_count = header.alive_count;
+        changes.clear();
+    }
+    /**
+     * @brief Replace every entity with a copy of the entities of another EntityManager, keeping their handles
+     * @param other EntityManager to copy
+     */
+    void copyFrom(const EntityManager& other)
+    {
+        if (other.alive_count > max_entities)
+            throw RuntimeException("EntityManager::copyFrom", "The copied manager holds more entities than the Maximum number of entity");
+        entities.assign(other.entities.begin(), other.entities.end());
+        signatures.assign(other.signatures.begin(), other.signatures.end());
+        free_list = other.free_list;
+        alive_count = other.alive_count;
+        changes.clear();
+        if (tick_source && other.tick_source)
+            changes.assign(other.changes.begin(), other.changes.end());
+    }
+    /**
+     * @brief Start recording the tick at which entities are created and destroyed
+     * @param tick Current tick, read whenever a change is recorded, must outlive the manager
+     */
+    void enableChangeTracking(const std::uint32_t* tick)
+    {
+        tick_source = tick;
+    }
+    /**
+     * @brief Get the entities created and destroyed after a tick
+     *
+     * An entity created then destroyed after the tick appears in neither list.
+     * @param since Tick of the previous delta
+     * @param created Receives the entities created after the tick and still alive
+     * @param destroyed Receives the entities alive at the tick and destroyed since
+     */
+    void collectChanges(std::uint32_t since, std::vector<Entity>& created, std::vector<Entity>& destroyed) const
+    {
+        std::vector<Entity> created_since;
+
+        for (const Change& change : changes)
+            if (change.tick > since && change.created)
+                created_since.push_back(change.entity);
+        std::sort(created_since.begin(), created_since.end());
+        for (const Change& change : changes) {
+            if (change.tick <= since)
+                continue;
+            if (change.created && isAlive(change.entity))
+                created.push_back(change.entity);
+            else if (!change.created && !std::binary_search(created_since.begin(), created_since.end(), change.entity))
+                destroyed.push_back(change.entity);
+        }
+    }
+    /**
+     * @brief Forget the creations and destructions recorded up to a tick
+     * @param tick Last tick to forget
+     */
+    void discardChanges(std::uint32_t tick)
+    {
+        std::erase_if(changes, [tick](const Change& change) { return (change.tick <= tick); });
+    }
+    /**
+     * @brief Make entities created elsewhere alive with the same handles, used to apply a delta
+     *
+     * The slot of each entity must be free. The free list is rebuilt once all entities are placed.
+     * @param adopted Entities to make alive
+     * @param count Number of entities
+     */
+    void adopt(const Entity* adopted, std::size_t count)
+    {
+        if (count == 0)
+            return;
+        if (count > max_entities - alive_count)
+            throw RuntimeException("EntityManager::adopt", "Not enough available entities, the Maximum number of entity would be exceeded");
+        for (std::size_t i = 0; i < count; i++) {
+            std::uint32_t index = entityIndex(adopted[i]);
+
+            if (index >= entities.size()) {
+                std::size_t first = entities.size();
+
+                entities.resize(index + 1);
+                signatures.resize(index + 1);
+                // new slots are free, they are chained by the rebuild below
+                for (std::size_t slot = first; slot < entities.size(); slot++)
+                    entities[slot] = makeEntity(FREE_LIST_END, 0);
+            } else if (entityIndex(entities[index]) == index) {
+                throw RuntimeException("EntityManager::adopt", "The slot of an adopted entity is already used by a live entity");
+            }
+            entities[index] = adopted[i];
+            signatures[index].reset();
+            logChange(adopted[i], true);
+        }
+        free_list = FREE_LIST_END;
+        alive_count = 0;
+        for (std::size_t index = entities.size(); index-- > 0;) {
+            if (entityIndex(entities[index]) == index) {
+                alive_count++;
+                continue;
+            }
+            entities[index] = makeEntity(free_list, entityVersion(entities[index]));
+            free_list = static_cast<std::uint32_t>(index);
+        }
+    }
+    /**
+     * @brief Get the maximum number of entities alive at the same time
+     * @return std::uint32_t Maximum number of entities
+     */
+    std::uint32_t getMaxEntities() const
+    {
+        return (max_entities);
+    }
+    /**
+     * @brief Get the number of entities alive
+     * @return std::uint32_t Number of entities
+     */
+    std::uint32_t getAliveCount() const
+    {
+        return (alive_count);
     }
 
 private:
-    std::array<Signature, MAX_ENTITIES> signatures;
-    std::queue<Entity> available_entities;
+    static constexpr std::uint32_t FREE_LIST_END = ENTITY_INDEX_MASK;
+
+    /**
+     * @brief Creation or destruction of an entity, logged when change tracking is enabled
+     */
+    struct Change {
+        Entity entity;
+        std::uint32_t tick;
+        bool created;
+    };
+
+    std::uint32_t max_entities;
+    std::uint32_t alive_count = 0;
+    std::uint32_t free_list = FREE_LIST_END;
+    std::pmr::vector<Entity> entities;
+    std::pmr::vector<Signature> signatures;
+    const std::uint32_t* tick_source = nullptr;
+    std::pmr::vector<Change> changes;
+
+    /**
+     * @brief Log the creation or destruction of an entity, when change tracking is enabled
+     */
+    void logChange(Entity entity, bool created)
+    {
+        if (tick_source)
+            changes.push_back(Change { entity, *tick_source, created });
+    }
 };
 
 }
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "ComponentArray.hpp"
+#include "Observer.hpp"
+#include "SoA.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief Interface for Group
+ */
+class IGroup {
+public:
+    virtual ~IGroup() = default;
+    /**
+     * @brief Rebuild the leading range of the owned arrays after they were replaced without events
+     */
+    virtual void refresh() = 0;
+};
+
+/**
+ * @brief Group owns several ComponentArrays and keeps the entities owning all of them in the same leading range
+ *
+ * The entity at position i < size() is the same in every owned array, so iterating the group walks the
+ * arrays in lockstep with no sparse lookup. The range is maintained from the construct and destroy
+ * events of the arrays: an entity completing the set is swapped to the end of the range, an entity
+ * losing one of the components is swapped out of it before the component is removed. An array can
+ * only be owned by one group, and an owned array is sorted through its group. Arrays of components with
+ * a SoALayout can be owned too, their field spans are then in lockstep over the first size() positions.
+ * @tparam ComponentTs Types of the owned components
+ */
+template<typename... ComponentTs>
+class Group : public IGroup {
+    static_assert(sizeof...(ComponentTs) > 0, "A Group needs at least one component type");
+
+public:
+    /**
+     * @brief Construct a new Group object, the owned arrays are reordered to form the range
+     * @param arrays ComponentArrays of the owned component types
+     */
+    explicit Group(ComponentArray<ComponentTs>*... arrays)
+        : arrays(arrays...)
+    {
+        std::apply([this](auto*... array) { (connect(array->getSignal(ComponentEvent::Construct), &Group::entityCompleted), ...); }, this->arrays);
+        std::apply([this](auto*... array) { (connect(array->getSignal(ComponentEvent::Destroy), &Group::entityLeaving), ...); }, this->arrays);
+        refresh();
+    }
+    Group(const Group&) = delete;
+    Group& operator=(const Group&) = delete;
+    ~Group() override
+    {
+        for (auto& [signal, connection] : connections)
+            signal->disconnect(connection);
+    }
+    /**
+     * @brief Rebuild the leading range of the owned arrays, keeping the order of the entities already in it
+     */
+    void refresh() override
+    {
+        const SparseSet& entities = std::get<0>(arrays)->getEntities();
+
+        length = 0;
+        for (std::size_t index = 0; index < entities.size(); index++)
+            if (ownsAll(entities[index]))
+                moveIn(entities[index]);
+    }
+    /**
+     * @brief Get the number of entities owning every component of the group
+     * @return std::size_t Length of the leading range
+     */
+    std::size_t size() const
+    {
+        return (length);
+    }
+    /**
+     * @brief Check if an entity is part of the group
+     * @param entity Entity to check
+     * @return true if the entity owns every component of the group, false otherwise
+     */
+    bool contains(Entity entity) const
+    {
+        const SparseSet& entities = std::get<0>(arrays)->getEntities();
+
+        return (entities.contains(entity) && entities.index(entity) < length);
+    }
+    /**
+     * @brief Get the entity at a position of the range
+     * @param index Position in the range, lower than size()
+     * @return Entity Entity at this position
+     */
+    Entity entityAt(std::size_t index) const
+    {
+        return (std::get<0>(arrays)->getEntities()[index]);
+    }
+    /**
+     * @brief Get the component of an owned type at a position of the range
+     * @tparam ComponentT Owned component type
+     * @param index Position in the range, lower than size()
+     * @return ComponentT& Component of the entity at this position
+     */
+    template<typename ComponentT>
+    ComponentT& get(std::size_t index)
+    {
+        static_assert(!HasSoALayout<ComponentT>, "Components with a SoALayout are accessed through fields<ComponentT>()");
+        return (std::get<ComponentArray<ComponentT>*>(arrays)->at(index));
+    }
+    /**
+     * @brief Call a function on every entity of the group, walking the owned arrays in lockstep
+     *
+     * The function is called either with the entity followed by a reference to each component, or with
+     * the component references only. Components of the group must not be added or removed during the call.
+     * @param function Function to call
+     */
+    template<typename FunctionT>
+    void each(FunctionT&& function)
+    {
+        static_assert((!HasSoALayout<ComponentTs> && ...), "Components with a SoALayout are iterated through fields<ComponentT>() over the first size() positions");
+        for (std::size_t index = 0; index < length; index++)
+            call(function, index, std::index_sequence_for<ComponentTs...>());
+    }
+    /**
+     * @brief Sort the range by comparing one of the owned components, every owned array follows the same order
+     * @tparam ComponentT Owned component type compared
+     * @param compare Strict weak ordering of two components
+     */
+    template<typename ComponentT, typename CompareT>
+    void sort(CompareT compare)
+    {
+        std::get<ComponentArray<ComponentT>*>(arrays)->sort(std::move(compare), length);
+        follow(std::get<ComponentArray<ComponentT>*>(arrays)->getEntities());
+    }
+    /**
+     * @brief Sort the range by a key computed once per entity from one of the owned components, equal keys keep their order
+     * @tparam ComponentT Owned component type the key is computed from
+     * @param key Function returning the key of a component
+     */
+    template<typename ComponentT, typename KeyT>
+    void sortBy(KeyT key)
+    {
+        std::get<ComponentArray<ComponentT>*>(arrays)->sortBy(std::move(key), length);
+        follow(std::get<ComponentArray<ComponentT>*>(arrays)->getEntities());
+    }
+
+private:
+    std::tuple<ComponentArray<ComponentTs>*...> arrays;
+    std::vector<std::pair<Signal*, Signal::Connection>> connections;
+    std::size_t length = 0;
+
+    /**
+     * @brief Call a member function of the group on every event of a signal
+     */
+    void connect(Signal& signal, void (Group::*handler)(Entity))
+    {
+        connections.emplace_back(&signal, signal.connect([this, handler](Entity entity) { (this->*handler)(entity); }));
+    }
+    /**
+     * @brief Check if an entity owns every component of the group
+     */
+    bool ownsAll(Entity entity) const
+    {
+        return (std::apply([entity](auto*... array) { return ((array->getEntities().contains(entity) && ...)); }, arrays));
+    }
+    /**
+     * @brief Swap an entity owning every component to the end of the range and grow the range
+     */
+    void moveIn(Entity entity)
+    {
+        std::apply([this, entity](auto*... array) { (array->swapPositions(array->getEntities().index(entity), length), ...); }, arrays);
+        length++;
+    }
+    /**
+     * @brief Add an entity to the range once it owns every component
+     */
+    void entityCompleted(Entity entity)
+    {
+        if (!contains(entity) && ownsAll(entity))
+            moveIn(entity);
+    }
+    /**
+     * @brief Swap an entity out of the range before one of its components is removed
+     */
+    void entityLeaving(Entity entity)
+    {
+        if (!contains(entity))
+            return;
+        length--;
+        std::apply([this, entity](auto*... array) { (array->swapPositions(array->getEntities().index(entity), length), ...); }, arrays);
+    }
+    /**
+     * @brief Reorder the range of every owned array like the range of a sorted one
+     *
+     * Positions before i already hold the entities sorted before the entity at i, so it is found at i or after.
+     */
+    void follow(const SparseSet& sorted)
+    {
+        for (std::size_t index = 0; index < length; index++)
+            std::apply([&sorted, index](auto*... array) { (array->swapPositions(array->getEntities().index(sorted[index]), index), ...); }, arrays);
+    }
+    /**
+     * @brief Call the function with the components at a position of the range
+     */
+    template<typename FunctionT, std::size_t... Is>
+    void call(FunctionT& function, std::size_t index, std::index_sequence<Is...>)
+    {
+        if constexpr (std::is_invocable_v<FunctionT&, Entity, ComponentTs&...>)
+            function(entityAt(index), std::get<Is>(arrays)->at(index)...);
+        else
+            function(std::get<Is>(arrays)->at(index)...);
+    }
+};
+}
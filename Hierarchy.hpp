@@ -0,0 +1,291 @@
+#pragma once
+
+#include "RuntimeException.hpp"
+#include "SparseSet.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief Breadth-first order of the entities of a hierarchy, rebuilt by the HierarchyManager when it changes
+ *
+ * Every entity comes after its parent and the children of an entity are contiguous, so a pass over the
+ * order updates each parent before its children. The entities of depth d are in [levels[d], levels[d + 1]),
+ * none of them is the parent of another, so each level can be processed in parallel.
+ */
+struct HierarchyOrder {
+    std::pmr::vector<Entity> entities;
+    /**
+     * @brief Position in entities of the parent of the entity at the same position, its own position for a root
+     */
+    std::pmr::vector<std::uint32_t> parents;
+    std::pmr::vector<std::size_t> levels;
+};
+
+/**
+ * @brief HierarchyManager stores the parent and children of the entities taking part in a hierarchy
+ *
+ * An entity is in the hierarchy while it has a parent or children, other entities cost nothing. The
+ * children of an entity form a list linked through their nodes, in the order they were attached. The
+ * breadth-first order used by propagation is rebuilt on demand after the hierarchy changed.
+ */
+class HierarchyManager {
+public:
+    /**
+     * @brief Construct a new HierarchyManager object
+     * @param resource Memory resource the nodes and the order are allocated from
+     */
+    explicit HierarchyManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : entities(resource)
+        , nodes(resource)
+        , order { std::pmr::vector<Entity>(resource), std::pmr::vector<std::uint32_t>(resource), std::pmr::vector<std::size_t>(resource) }
+    {
+    }
+    /**
+     * @brief Attach an entity to a parent, detaching it from its previous parent
+     * @param child Entity to attach
+     * @param parent New parent of the entity, must not be the entity itself or one of its descendants
+     */
+    void setParent(Entity child, Entity parent)
+    {
+        for (Entity ancestor = parent; ancestor != NULL_ENTITY; ancestor = getParent(ancestor))
+            if (ancestor == child)
+                throw RuntimeException("HierarchyManager::setParent", "An entity cannot be attached to itself or to one of its descendants");
+        if (getParent(child) == parent)
+            return;
+        detach(child);
+        assure(parent);
+        assure(child);
+        Node& parent_node = node(parent);
+        Node& child_node = node(child);
+
+        child_node.parent = parent;
+        child_node.previous = parent_node.last_child;
+        if (parent_node.last_child == NULL_ENTITY)
+            parent_node.first_child = child;
+        else
+            node(parent_node.last_child).next = child;
+        parent_node.last_child = child;
+        dirty = true;
+    }
+    /**
+     * @brief Detach an entity from its parent, making it a root
+     * @param child Entity to detach
+     */
+    void removeParent(Entity child)
+    {
+        if (!entities.contains(child))
+            return;
+        detach(child);
+        prune(child);
+    }
+    /**
+     * @brief Get the parent of an entity
+     * @param entity Entity to get the parent of
+     * @return Entity Parent of the entity, NULL_ENTITY for an entity without parent
+     */
+    Entity getParent(Entity entity) const
+    {
+        return (entities.contains(entity) ? nodes[entities.index(entity)].parent : NULL_ENTITY);
+    }
+    /**
+     * @brief Call a function on every child of an entity, in the order they were attached
+     * @param entity Entity to visit the children of
+     * @param function Function called with each child, must not change the hierarchy
+     */
+    template<typename FunctionT>
+    void eachChild(Entity entity, FunctionT&& function) const
+    {
+        if (!entities.contains(entity))
+            return;
+        for (Entity child = nodes[entities.index(entity)].first_child; child != NULL_ENTITY; child = nodes[entities.index(child)].next)
+            function(child);
+    }
+    /**
+     * @brief Check if an entity has a parent or children
+     * @param entity Entity to check
+     * @return true if the entity is part of the hierarchy, false otherwise
+     */
+    bool contains(Entity entity) const
+    {
+        return (entities.contains(entity));
+    }
+    /**
+     * @brief Append the descendants of an entity to a list, level by level
+     * @param entity Entity to collect the descendants of
+     * @param descendants List the descendants are appended to
+     */
+    void collectDescendants(Entity entity, std::vector<Entity>& descendants) const
+    {
+        std::size_t next = descendants.size();
+
+        eachChild(entity, [&descendants](Entity child) { descendants.push_back(child); });
+        while (next < descendants.size())
+            eachChild(descendants[next++], [&descendants](Entity child) { descendants.push_back(child); });
+    }
+    /**
+     * @brief Remove destroyed entities from the hierarchy, their children become roots
+     * @param destroyed Entities destroyed
+     * @param count Number of entities destroyed
+     */
+    void entitiesDestroyed(const Entity* destroyed, std::size_t count)
+    {
+        if (entities.empty())
+            return;
+        for (std::size_t i = 0; i < count; i++) {
+            Entity entity = destroyed[i];
+
+            if (!entities.contains(entity))
+                continue;
+            detach(entity);
+            for (Entity child = node(entity).first_child; child != NULL_ENTITY;) {
+                Node& child_node = node(child);
+                Entity next = child_node.next;
+
+                child_node.parent = NULL_ENTITY;
+                child_node.previous = NULL_ENTITY;
+                child_node.next = NULL_ENTITY;
+                prune(child);
+                child = next;
+            }
+            node(entity).first_child = NULL_ENTITY;
+            node(entity).last_child = NULL_ENTITY;
+            prune(entity);
+        }
+    }
+    /**
+     * @brief Get the breadth-first order of the hierarchy, rebuilt if the hierarchy changed since the last call
+     * @return const HierarchyOrder& Order of the entities of the hierarchy, invalidated by the next change
+     */
+    const HierarchyOrder& getOrder()
+    {
+        if (dirty)
+            rebuildOrder();
+        return (order);
+    }
+    /**
+     * @brief Remove every entity from the hierarchy
+     */
+    void clear()
+    {
+        entities.clear();
+        nodes.clear();
+        dirty = true;
+    }
+    /**
+     * @brief Replace the hierarchy with a copy of another one
+     * @param other HierarchyManager to copy
+     */
+    void copyFrom(const HierarchyManager& other)
+    {
+        entities.copyFrom(other.entities);
+        nodes.assign(other.nodes.begin(), other.nodes.end());
+        dirty = true;
+    }
+
+private:
+    /**
+     * @brief Links of an entity to its parent, its siblings and the ends of its list of children
+     */
+    struct Node {
+        Entity parent = NULL_ENTITY;
+        Entity first_child = NULL_ENTITY;
+        Entity last_child = NULL_ENTITY;
+        Entity previous = NULL_ENTITY;
+        Entity next = NULL_ENTITY;
+    };
+
+    SparseSet entities;
+    std::pmr::vector<Node> nodes;
+    HierarchyOrder order;
+    bool dirty = true;
+
+    /**
+     * @brief Get the node of an entity of the hierarchy
+     */
+    Node& node(Entity entity)
+    {
+        return (nodes[entities.index(entity)]);
+    }
+    /**
+     * @brief Add an entity to the hierarchy if it is not part of it yet
+     */
+    void assure(Entity entity)
+    {
+        if (entities.contains(entity))
+            return;
+        entities.insert(entity);
+        nodes.emplace_back();
+    }
+    /**
+     * @brief Unlink an entity from the children of its parent, the parent leaves the hierarchy if it has nothing left
+     */
+    void detach(Entity child)
+    {
+        if (!entities.contains(child) || node(child).parent == NULL_ENTITY)
+            return;
+        Node& child_node = node(child);
+        Entity parent = child_node.parent;
+        Node& parent_node = node(parent);
+
+        if (child_node.previous == NULL_ENTITY)
+            parent_node.first_child = child_node.next;
+        else
+            node(child_node.previous).next = child_node.next;
+        if (child_node.next == NULL_ENTITY)
+            parent_node.last_child = child_node.previous;
+        else
+            node(child_node.next).previous = child_node.previous;
+        child_node = Node { NULL_ENTITY, child_node.first_child, child_node.last_child, NULL_ENTITY, NULL_ENTITY };
+        prune(parent);
+        dirty = true;
+    }
+    /**
+     * @brief Remove an entity from the hierarchy once it has neither parent nor children
+     */
+    void prune(Entity entity)
+    {
+        const Node& entity_node = node(entity);
+
+        if (entity_node.parent != NULL_ENTITY || entity_node.first_child != NULL_ENTITY)
+            return;
+        std::size_t position = entities.erase(entity);
+
+        nodes[position] = nodes.back();
+        nodes.pop_back();
+        dirty = true;
+    }
+    /**
+     * @brief Rebuild the breadth-first order from the roots, in the order of the nodes
+     */
+    void rebuildOrder()
+    {
+        order.entities.clear();
+        order.parents.clear();
+        order.levels.clear();
+        for (std::size_t index = 0; index < nodes.size(); index++) {
+            if (nodes[index].parent == NULL_ENTITY) {
+                order.parents.push_back(static_cast<std::uint32_t>(order.entities.size()));
+                order.entities.push_back(entities[index]);
+            }
+        }
+        for (std::size_t begin = 0; begin < order.entities.size();) {
+            std::size_t end = order.entities.size();
+
+            order.levels.push_back(begin);
+            for (std::size_t position = begin; position < end; position++) {
+                for (Entity child = node(order.entities[position]).first_child; child != NULL_ENTITY; child = node(child).next) {
+                    order.parents.push_back(static_cast<std::uint32_t>(position));
+                    order.entities.push_back(child);
+                }
+            }
+            begin = end;
+        }
+        order.levels.push_back(order.entities.size());
+        dirty = false;
+    }
+};
+}
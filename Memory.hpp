@@ -0,0 +1,254 @@
+#pragma once
+
+#include "RuntimeException.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ECS {
+/**
+ * @brief Deleter returning a block to the memory resource it was allocated from
+ */
+struct ResourceDeleter {
+    std::pmr::memory_resource* resource = nullptr;
+    std::size_t size = 0;
+    std::size_t alignment = alignof(std::max_align_t);
+
+    void operator()(void* memory) const
+    {
+        resource->deallocate(memory, size, alignment);
+    }
+};
+
+/**
+ * @brief Block of memory owned by a memory resource, released to it when the pointer is destroyed
+ */
+template<typename T>
+using ResourcePtr = std::unique_ptr<T[], ResourceDeleter>;
+
+/**
+ * @brief Allocate an uninitialized array from a memory resource
+ * @tparam T Type of the elements, left uninitialized so it must be trivial
+ * @param resource Memory resource to allocate from
+ * @param count Number of elements
+ * @param alignment Alignment of the array, at least the alignment of T
+ * @return ResourcePtr<T> Owner of the array
+ */
+template<typename T>
+ResourcePtr<T> allocateArray(std::pmr::memory_resource* resource, std::size_t count, std::size_t alignment = alignof(T))
+{
+    static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>, "Arrays allocated from a resource are not constructed nor destroyed");
+    alignment = std::max(alignment, alignof(T));
+    void* memory = resource->allocate(count * sizeof(T), alignment);
+
+    return (ResourcePtr<T>(static_cast<T*>(memory), ResourceDeleter { resource, count * sizeof(T), alignment }));
+}
+
+/**
+ * @brief PagePoolResource is an unsynchronized memory resource carving fixed-size slots out of large aligned blocks
+ *
+ * Requests are rounded up to a power of two size class. Every block serves a single size class, so
+ * slots are naturally aligned to their size and freed slots are kept in a free list of their class
+ * for the next allocation of the same class. Requests larger than an eighth of a block get a dedicated
+ * run rounded up to whole pages, aligned to a block once it spans one. Blocks are aligned to their size so that the kernel can back them with
+ * transparent huge pages, and can be explicitly advised for them on Linux. Every block is returned to
+ * the system when the resource is released or destroyed, whether or not the memory was deallocated, so
+ * a world allocated from it is torn down in a few large frees. The resource must outlive everything
+ * allocated from it and must not be used from several threads at the same time.
+ */
+class PagePoolResource : public std::pmr::memory_resource {
+public:
+    /**
+     * @brief Default size of a block, the size of a huge page on x86-64 and most aarch64 kernels
+     */
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = std::size_t(2) << 20;
+    /**
+     * @brief Smallest size class, smaller requests are rounded up to it
+     */
+    static constexpr std::size_t MIN_SLOT_SIZE = 16;
+    /**
+     * @brief Granularity of the dedicated runs of large requests
+     */
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    /**
+     * @brief Construct a new PagePoolResource object
+     * @param block_size Size of a block, rounded up to a power of two of at least 64 KiB
+     * @param huge_pages Advise the kernel to back blocks with huge pages, which speeds up later accesses
+     * but makes the first touch of each block slower as the kernel may have to compact memory
+     */
+    explicit PagePoolResource(std::size_t block_size = DEFAULT_BLOCK_SIZE, bool huge_pages = false)
+        : block_size(std::bit_ceil(std::max(block_size, std::size_t(64) << 10)))
+        , huge_pages(huge_pages)
+    {
+    }
+    PagePoolResource(const PagePoolResource&) = delete;
+    PagePoolResource& operator=(const PagePoolResource&) = delete;
+    ~PagePoolResource() override
+    {
+        release();
+    }
+    /**
+     * @brief Return every block to the system, invalidating all the memory allocated from the resource
+     */
+    void release()
+    {
+        for (std::byte* block : blocks)
+            ::operator delete(block, std::align_val_t(block_size));
+        for (const auto& [memory, run] : runs)
+            ::operator delete(memory, std::align_val_t(run.alignment));
+        blocks.clear();
+        runs.clear();
+        classes.fill(SizeClass {});
+    }
+    /**
+     * @brief Get the number of bytes held from the system, in blocks
+     * @return std::size_t Number of bytes
+     */
+    std::size_t getReservedBytes() const
+    {
+        std::size_t total = blocks.size() * block_size;
+
+        for (const auto& [memory, run] : runs)
+            total += run.size;
+        return (total);
+    }
+    /**
+     * @brief Get the size of a block
+     * @return std::size_t Size of a block
+     */
+    std::size_t getBlockSize() const
+    {
+        return (block_size);
+    }
+
+private:
+    /**
+     * @brief Slot of the free list of a size class, stored in the freed memory itself
+     */
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+    /**
+     * @brief Block currently carved for a size class and the freed slots of that class
+     */
+    struct SizeClass {
+        FreeSlot* free_list = nullptr;
+        std::byte* cursor = nullptr;
+        std::byte* end = nullptr;
+    };
+    /**
+     * @brief Dedicated run of a large request, held from the system
+     */
+    struct Run {
+        std::size_t size;
+        std::size_t alignment;
+    };
+
+    std::size_t block_size;
+    bool huge_pages;
+    std::array<SizeClass, 64> classes {};
+    std::vector<std::byte*> blocks;
+    std::unordered_map<std::byte*, Run> runs;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        std::size_t size = std::bit_ceil(std::max({ bytes, alignment, MIN_SLOT_SIZE }));
+
+        if (alignment > block_size)
+            throw RuntimeException("PagePoolResource::allocate", "Alignment larger than a block");
+        if (size > block_size / 8) {
+            std::size_t run = (bytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+            std::size_t run_alignment = run >= block_size ? block_size : std::max(alignment, PAGE_SIZE);
+            std::byte* memory = allocateMemory(run, run_alignment);
+
+            runs.emplace(memory, Run { run, run_alignment });
+            return (memory);
+        }
+        SizeClass& size_class = classes[std::countr_zero(size)];
+
+        if (size_class.free_list) {
+            FreeSlot* slot = size_class.free_list;
+
+            size_class.free_list = slot->next;
+            return (slot);
+        }
+        if (size_class.cursor == size_class.end) {
+            size_class.cursor = allocateMemory(block_size, block_size);
+            blocks.push_back(size_class.cursor);
+            size_class.end = size_class.cursor + block_size;
+        }
+        void* slot = size_class.cursor;
+
+        size_class.cursor += size;
+        return (slot);
+    }
+    /**
+     * @brief Return memory to the resource, memory it does not hold is a caller bug only checked by assertions
+     *
+     * Deallocation runs from destructors, so it never throws: an unknown large run is ignored.
+     */
+    void do_deallocate(void* memory, std::size_t bytes, std::size_t alignment) override
+    {
+        std::size_t size = std::bit_ceil(std::max({ bytes, alignment, MIN_SLOT_SIZE }));
+
+        if (size > block_size / 8) {
+            auto run = runs.find(static_cast<std::byte*>(memory));
+
+            assert(run != runs.end() && "PagePoolResource::deallocate: the memory was not allocated from this resource");
+            if (run == runs.end())
+                return;
+            ::operator delete(run->first, std::align_val_t(run->second.alignment));
+            runs.erase(run);
+            return;
+        }
+        assert(ownsSlot(memory) && "PagePoolResource::deallocate: the memory was not allocated from this resource");
+        SizeClass& size_class = classes[std::countr_zero(size)];
+
+        size_class.free_list = ::new (memory) FreeSlot { size_class.free_list };
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return (this == &other);
+    }
+    /**
+     * @brief Check if a slot lies in one of the blocks of the size classes, blocks being aligned to their size
+     */
+    bool ownsSlot(void* memory) const
+    {
+        std::byte* block = reinterpret_cast<std::byte*>(reinterpret_cast<std::uintptr_t>(memory) & ~(block_size - 1));
+
+        return (std::find(blocks.begin(), blocks.end(), block) != blocks.end());
+    }
+    /**
+     * @brief Get memory from the system
+     * @param size Size of the memory, a multiple of the page size
+     * @param alignment Alignment of the memory, the block size for blocks and runs meant for huge pages
+     * @return std::byte* Start of the memory
+     */
+    std::byte* allocateMemory(std::size_t size, std::size_t alignment)
+    {
+        std::byte* memory = static_cast<std::byte*>(::operator new(size, std::align_val_t(alignment)));
+
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
+            madvise(memory, size, MADV_HUGEPAGE);
+#endif
+        return (memory);
+    }
+};
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "SparseSet.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief Events emitted by a ComponentArray
+ */
+enum class ComponentEvent {
+    /**
+     * @brief A component was added to an entity, emitted once the component is stored
+     */
+    Construct,
+    /**
+     * @brief A component is removed from an entity or its entity destroyed, emitted while the component is still stored
+     */
+    Destroy,
+    /**
+     * @brief A component was overwritten as a whole through replaceComponent, emitted once the new value is stored
+     */
+    Replace
+};
+
+/**
+ * @brief Signal calls its listeners with the entity an event happened to
+ *
+ * Listeners run synchronously inside the structural change, so they must not add or remove components of
+ * the type that emitted the event, nor connect or disconnect listeners of the same signal.
+ */
+class Signal {
+public:
+    using Listener = std::function<void(Entity)>;
+    using Connection = std::size_t;
+
+    /**
+     * @brief Add a listener
+     * @param listener Function called with the entity of each event
+     * @return Connection Identifier of the listener, to disconnect it
+     */
+    Connection connect(Listener listener)
+    {
+        listeners.emplace_back(next_connection, std::move(listener));
+        return (next_connection++);
+    }
+    /**
+     * @brief Remove a listener
+     * @param connection Identifier returned by connect
+     */
+    void disconnect(Connection connection)
+    {
+        std::erase_if(listeners, [connection](const auto& listener) { return (listener.first == connection); });
+    }
+    /**
+     * @brief Check if the signal has no listener, emitters skip the event entirely in that case
+     * @return true if no listener is connected, false otherwise
+     */
+    bool empty() const
+    {
+        return (listeners.empty());
+    }
+    /**
+     * @brief Call every listener with an entity
+     * @param entity Entity the event happened to
+     */
+    void emit(Entity entity) const
+    {
+        for (const auto& listener : listeners)
+            listener.second(entity);
+    }
+
+private:
+    std::vector<std::pair<Connection, Listener>> listeners;
+    Connection next_connection = 0;
+};
+
+/**
+ * @brief ReactiveList collects the entities signals were emitted for, to be drained by a system once per frame
+ *
+ * Each entity is kept once whatever the number of events. The order of the entities is unspecified:
+ * discarding an entity moves the last collected entity in its place. The list disconnects from its
+ * signals when destroyed, so it must not outlive the coordinator it observes.
+ */
+class ReactiveList {
+public:
+    ReactiveList() = default;
+    ReactiveList(const ReactiveList&) = delete;
+    ReactiveList& operator=(const ReactiveList&) = delete;
+    ~ReactiveList()
+    {
+        for (auto& [signal, connection] : connections)
+            signal->disconnect(connection);
+    }
+    /**
+     * @brief Add the entities of every event of a signal to the list
+     * @param signal Signal to listen to
+     */
+    void collect(Signal& signal)
+    {
+        connections.emplace_back(&signal, signal.connect([this](Entity entity) {
+            if (!entities.contains(entity))
+                entities.insert(entity);
+        }));
+    }
+    /**
+     * @brief Remove the entities of every event of a signal from the list, for example when they lost the observed component
+     * @param signal Signal to listen to
+     */
+    void discard(Signal& signal)
+    {
+        connections.emplace_back(&signal, signal.connect([this](Entity entity) {
+            if (entities.contains(entity))
+                entities.erase(entity);
+        }));
+    }
+    /**
+     * @brief Call a function on every collected entity then empty the list
+     *
+     * The list is emptied before the calls, the function may change the world and the events it
+     * triggers are collected for the next drain.
+     * @param function Function called with each entity
+     */
+    template<typename FunctionT>
+    void drain(FunctionT&& function)
+    {
+        draining.assign(entities.begin(), entities.end());
+        entities.clear();
+        for (Entity entity : draining)
+            function(entity);
+        draining.clear();
+    }
+    /**
+     * @brief Check if an entity is in the list
+     * @param entity Entity to check
+     * @return true if an event was collected for the entity since the last drain, false otherwise
+     */
+    bool contains(Entity entity) const
+    {
+        return (entities.contains(entity));
+    }
+    /**
+     * @brief Get the number of entities in the list
+     * @return std::size_t Number of entities
+     */
+    std::size_t size() const
+    {
+        return (entities.size());
+    }
+    /**
+     * @brief Check if the list is empty
+     * @return true if no event was collected since the last drain, false otherwise
+     */
+    bool empty() const
+    {
+        return (entities.empty());
+    }
+    /**
+     * @brief Empty the list without visiting it
+     */
+    void clear()
+    {
+        entities.clear();
+    }
+
+private:
+    SparseSet entities;
+    std::vector<Entity> draining;
+    std::vector<std::pair<Signal*, Signal::Connection>> connections;
+};
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "SparseSet.hpp"
+#include "ThreadPool.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief Number of entities sharing a cache line of a dense entity array
+ */
+constexpr std::size_t ENTITIES_PER_CACHE_LINE = 64 / sizeof(Entity);
+
+/**
+ * @brief PerThread holds one value per thread of a ThreadPool, to accumulate results without synchronization
+ *
+ * Values are padded to a cache line each so threads do not share lines. Threads that are not workers
+ * of the pool all use the same extra value, only the thread waiting on a parallel call should touch it.
+ * @tparam T Type of the values
+ */
+template<typename T>
+class PerThread {
+public:
+    /**
+     * @brief Construct a new PerThread object
+     * @param pool ThreadPool whose threads get a value
+     * @param value Initial value of every thread
+     */
+    explicit PerThread(const ThreadPool& pool, const T& value = T())
+        : pool(pool)
+        , values(pool.size() + 1, Slot { value })
+    {
+    }
+    /**
+     * @brief Get the value of the calling thread
+     * @return T& Value of the thread
+     */
+    T& local()
+    {
+        return (values[pool.currentThread()].value);
+    }
+    /**
+     * @brief Combine the values of every thread, in thread order
+     * @param value Initial value of the combination
+     * @param combine Function combining the current result with the value of a thread
+     * @return T Combined value
+     */
+    template<typename CombineT>
+    T combine(T value, CombineT&& combine) const
+    {
+        for (const Slot& slot : values)
+            value = combine(value, slot.value);
+        return (value);
+    }
+
+private:
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    const ThreadPool& pool;
+    std::vector<Slot> values;
+};
+
+/**
+ * @brief Compute the default chunk size to split a range over a pool
+ * @param pool ThreadPool the range is split over
+ * @param count Number of elements of the range
+ * @return std::size_t Chunk size, a multiple of ENTITIES_PER_CACHE_LINE
+ */
+inline std::size_t defaultChunkSize(const ThreadPool& pool, std::size_t count)
+{
+    constexpr std::size_t MIN_CHUNK_SIZE = 256;
+    constexpr std::size_t CHUNKS_PER_THREAD = 8;
+    std::size_t chunk_size = std::max(MIN_CHUNK_SIZE, count / (pool.size() * CHUNKS_PER_THREAD));
+
+    return ((chunk_size + ENTITIES_PER_CACHE_LINE - 1) / ENTITIES_PER_CACHE_LINE * ENTITIES_PER_CACHE_LINE);
+}
+
+/**
+ * @brief Split [0, count) in chunks and run a function on each chunk on the pool, returning once every chunk is done
+ * @param pool ThreadPool running the chunks, the calling thread helps while waiting
+ * @param count Number of elements
+ * @param function Function called with the [begin, end) bounds of a chunk
+ * @param chunk_size Number of elements of a chunk, 0 to use defaultChunkSize
+ */
+template<typename FunctionT>
+void parallelFor(ThreadPool& pool, std::size_t count, FunctionT&& function, std::size_t chunk_size = 0)
+{
+    if (chunk_size == 0)
+        chunk_size = defaultChunkSize(pool, count);
+    if (count <= chunk_size) {
+        function(std::size_t(0), count);
+        return;
+    }
+    TaskGroup group(pool);
+
+    for (std::size_t begin = 0; begin < count; begin += chunk_size) {
+        std::size_t end = std::min(count, begin + chunk_size);
+
+        group.run([&function, begin, end] { function(begin, end); });
+    }
+    group.wait();
+}
+
+/**
+ * @brief Call a function on every entity of a SparseSet, such as System::entities, in parallel
+ * @param pool ThreadPool running the chunks
+ * @param entities Entities to iterate over, must not change during the call
+ * @param function Function called with each entity
+ * @param chunk_size Number of entities of a chunk, 0 to use defaultChunkSize
+ */
+template<typename FunctionT>
+void parallelEach(ThreadPool& pool, const SparseSet& entities, FunctionT&& function, std::size_t chunk_size = 0)
+{
+    const Entity* data = entities.data();
+
+    parallelFor(pool, entities.size(), [data, &function](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index < end; index++)
+            function(data[index]);
+    }, chunk_size);
+}
+}
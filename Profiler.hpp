@@ -0,0 +1,393 @@
+#pragma once
+
+/**
+ * @brief Keep a statement only when profiling is enabled by defining ECS_ENABLE_PROFILING
+ */
+#ifdef ECS_ENABLE_PROFILING
+#define ECS_PROFILE(...) __VA_ARGS__
+#else
+#define ECS_PROFILE(...)
+#endif
+
+#ifdef ECS_ENABLE_PROFILING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+namespace ECS {
+/**
+ * @brief Profiler records timed scopes and structural change counters, only compiled with ECS_ENABLE_PROFILING
+ *
+ * Each recording thread owns a ring buffer of events and a set of counters that only it writes to, so
+ * recording takes no lock. Rings are drained into the profiler history at the end of each frame, and
+ * events recorded while a ring is full are dropped and counted. The history grows until clear is called.
+ */
+class Profiler {
+public:
+    /**
+     * @brief Number of events a thread can record between two frame ends
+     */
+    static constexpr std::size_t RING_SIZE = 4096;
+
+    /**
+     * @brief Structural operations counted per frame
+     */
+    enum class Counter : std::uint8_t {
+        AddComponent,
+        RemoveComponent,
+        SignatureChanged,
+        Count,
+    };
+
+    /**
+     * @brief A timed scope
+     */
+    struct Event {
+        const char* name;
+        const char* category;
+        std::uint64_t start_ns;
+        std::uint64_t duration_ns;
+        std::uint64_t entities;
+        std::uint64_t frame;
+        std::uint32_t thread;
+    };
+
+    /**
+     * @brief Totals of a frame
+     */
+    struct FrameStats {
+        std::uint64_t frame = 0;
+        std::uint64_t start_ns = 0;
+        std::uint64_t duration_ns = 0;
+        std::array<std::uint64_t, static_cast<std::size_t>(Counter::Count)> counters {};
+    };
+
+    /**
+     * @brief Scope records the time spent between its construction and its destruction
+     */
+    class Scope {
+    public:
+        /**
+         * @brief Start timing a scope
+         * @param profiler Profiler to record to
+         * @param name Name of the scope, must outlive the profiler
+         * @param entities Number of entities processed in the scope
+         * @param category Category of the scope in the trace
+         */
+        Scope(Profiler& profiler, const char* name, std::uint64_t entities = 0, const char* category = "ecs")
+            : profiler(profiler)
+            , name(name)
+            , category(category)
+            , entities(entities)
+            , start(profiler.now())
+        {
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope()
+        {
+            profiler.record(name, category, start, profiler.now() - start, entities);
+        }
+
+    private:
+        Profiler& profiler;
+        const char* name;
+        const char* category;
+        std::uint64_t entities;
+        std::uint64_t start;
+    };
+
+    /**
+     * @brief Frame delimits a frame, the counters accumulated since the previous frame ended are attributed to it
+     */
+    class Frame {
+    public:
+        /**
+         * @brief Begin a frame
+         * @param profiler Profiler to record to
+         */
+        explicit Frame(Profiler& profiler)
+            : profiler(profiler)
+        {
+            profiler.beginFrame();
+        }
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+        ~Frame()
+        {
+            profiler.endFrame();
+        }
+
+    private:
+        Profiler& profiler;
+    };
+
+    Profiler()
+        : origin(std::chrono::steady_clock::now())
+    {
+    }
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    /**
+     * @brief Get the time elapsed since the creation of the profiler
+     * @return std::uint64_t Time in nanoseconds
+     */
+    std::uint64_t now() const
+    {
+        return (static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count()));
+    }
+    /**
+     * @brief Record a timed scope on the calling thread
+     * @param name Name of the scope, must outlive the profiler
+     * @param category Category of the scope in the trace
+     * @param start_ns Start of the scope
+     * @param duration_ns Duration of the scope
+     * @param entities Number of entities processed in the scope
+     */
+    void record(const char* name, const char* category, std::uint64_t start_ns, std::uint64_t duration_ns, std::uint64_t entities)
+    {
+        ThreadBuffer& buffer = localBuffer();
+        std::size_t head = buffer.head.load(std::memory_order_relaxed);
+
+        if (head - buffer.tail.load(std::memory_order_acquire) == RING_SIZE) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer.events[head % RING_SIZE] = Event { name, category, start_ns, duration_ns, entities, frame_index.load(std::memory_order_relaxed), buffer.thread };
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+    /**
+     * @brief Count structural operations on the calling thread
+     * @param counter Operation to count
+     * @param amount Number of operations
+     */
+    void count(Counter counter, std::uint64_t amount = 1)
+    {
+        localBuffer().counters[static_cast<std::size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+    /**
+     * @brief Begin a frame, scopes recorded from now on belong to it
+     */
+    void beginFrame()
+    {
+        frame_start = now();
+    }
+    /**
+     * @brief End the current frame: sum its counters, drain the rings and record the frame itself
+     */
+    void endFrame()
+    {
+        FrameStats stats;
+
+        stats.frame = frame_index.load(std::memory_order_relaxed);
+        stats.start_ns = frame_start;
+        stats.duration_ns = now() - frame_start;
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex);
+
+            for (auto const& buffer : buffers)
+                for (std::size_t counter = 0; counter < stats.counters.size(); counter++)
+                    stats.counters[counter] += buffer->counters[counter].exchange(0, std::memory_order_relaxed);
+        }
+        collect();
+        events.push_back(Event { "frame", "frame", stats.start_ns, stats.duration_ns, 0, stats.frame, localBuffer().thread });
+        frames.push_back(stats);
+        frame_index.fetch_add(1, std::memory_order_relaxed);
+    }
+    /**
+     * @brief Move the events recorded so far by every thread to the history
+     */
+    void collect()
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+
+        for (auto const& buffer : buffers) {
+            std::size_t tail = buffer->tail.load(std::memory_order_relaxed);
+            std::size_t head = buffer->head.load(std::memory_order_acquire);
+
+            for (; tail != head; tail++)
+                events.push_back(buffer->events[tail % RING_SIZE]);
+            buffer->tail.store(tail, std::memory_order_release);
+        }
+    }
+    /**
+     * @brief Get the recorded events, call collect first to include the events of the current frame
+     * @return const std::vector<Event>& Events in the order they were collected
+     */
+    const std::vector<Event>& getEvents() const
+    {
+        return (events);
+    }
+    /**
+     * @brief Get the totals of every ended frame
+     * @return const std::vector<FrameStats>& Totals, one per frame
+     */
+    const std::vector<FrameStats>& getFrames() const
+    {
+        return (frames);
+    }
+    /**
+     * @brief Get the number of events dropped because a ring was full
+     * @return std::uint64_t Number of dropped events
+     */
+    std::uint64_t getDroppedEvents() const
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        std::uint64_t dropped = 0;
+
+        for (auto const& buffer : buffers)
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        return (dropped);
+    }
+    /**
+     * @brief Forget the recorded events and frames
+     */
+    void clear()
+    {
+        collect();
+        events.clear();
+        frames.clear();
+    }
+    /**
+     * @brief Keep a copy of a name so that it can be given to record, used for names built at runtime
+     * @param name Name to keep
+     * @return const char* Copy living as long as the profiler
+     */
+    const char* intern(std::string name)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+
+        names.push_back(std::move(name));
+        return (names.back().c_str());
+    }
+    /**
+     * @brief Get the readable name of a type, demangled when the compiler allows it
+     * @tparam T Type to name
+     * @return const char* Name living as long as the profiler
+     */
+    template<typename T>
+    const char* typeName()
+    {
+        const char* mangled = typeid(T).name();
+#if __has_include(<cxxabi.h>)
+        int status = 0;
+        std::unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(mangled, nullptr, nullptr, &status), std::free);
+
+        if (status == 0 && demangled)
+            return (intern(demangled.get()));
+#endif
+        return (intern(mangled));
+    }
+    /**
+     * @brief Write the recorded events and frame counters as Chrome trace-event JSON, loadable in chrome://tracing or Perfetto
+     * @param stream Stream to write to
+     */
+    void exportChromeTrace(std::ostream& stream)
+    {
+        collect();
+        stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+
+        for (const Event& event : events) {
+            stream << (first ? "\n" : ",\n") << "{\"name\":\"";
+            writeEscaped(stream, event.name);
+            stream << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+                   << ",\"ts\":" << microseconds(event.start_ns) << ",\"dur\":" << microseconds(event.duration_ns)
+                   << ",\"args\":{\"frame\":" << event.frame << ",\"entities\":" << event.entities << "}}";
+            first = false;
+        }
+        for (const FrameStats& frame : frames) {
+            stream << (first ? "\n" : ",\n") << "{\"name\":\"structural changes\",\"ph\":\"C\",\"pid\":0,\"ts\":" << microseconds(frame.start_ns)
+                   << ",\"args\":{\"addComponent\":" << frame.counters[static_cast<std::size_t>(Counter::AddComponent)]
+                   << ",\"removeComponent\":" << frame.counters[static_cast<std::size_t>(Counter::RemoveComponent)]
+                   << ",\"entitySignatureChanged\":" << frame.counters[static_cast<std::size_t>(Counter::SignatureChanged)] << "}}";
+            first = false;
+        }
+        stream << "\n]}\n";
+    }
+
+private:
+    struct ThreadBuffer {
+        std::thread::id id;
+        std::uint32_t thread;
+        std::atomic<std::size_t> head { 0 };
+        std::atomic<std::size_t> tail { 0 };
+        std::atomic<std::uint64_t> dropped { 0 };
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(Counter::Count)> counters {};
+        std::array<Event, RING_SIZE> events;
+    };
+
+    struct LocalCache {
+        const Profiler* profiler;
+        std::uint64_t generation;
+        ThreadBuffer* buffer;
+    };
+
+    std::chrono::steady_clock::time_point origin;
+    std::uint64_t generation = next_generation.fetch_add(1, std::memory_order_relaxed);
+    mutable std::mutex buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::deque<std::string> names;
+    std::vector<Event> events;
+    std::vector<FrameStats> frames;
+    std::atomic<std::uint64_t> frame_index { 0 };
+    std::uint64_t frame_start = 0;
+
+    static inline std::atomic<std::uint64_t> next_generation { 1 };
+    static inline thread_local LocalCache local_cache;
+
+    /**
+     * @brief Get the ring of the calling thread, registering the thread on its first record
+     * @return ThreadBuffer& Ring of the calling thread
+     */
+    ThreadBuffer& localBuffer()
+    {
+        if (local_cache.profiler == this && local_cache.generation == generation)
+            return (*local_cache.buffer);
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        ThreadBuffer* found = nullptr;
+
+        for (auto const& buffer : buffers)
+            if (buffer->id == std::this_thread::get_id())
+                found = buffer.get();
+        if (!found) {
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            found = buffers.back().get();
+            found->id = std::this_thread::get_id();
+            found->thread = static_cast<std::uint32_t>(buffers.size() - 1);
+        }
+        local_cache = LocalCache { this, generation, found };
+        return (*found);
+    }
+    static double microseconds(std::uint64_t nanoseconds)
+    {
+        return (static_cast<double>(nanoseconds) / 1000.0);
+    }
+    static void writeEscaped(std::ostream& stream, const char* text)
+    {
+        for (; *text; text++) {
+            if (*text == '"' || *text == '\\')
+                stream << '\\';
+            stream << *text;
+        }
+    }
+};
+}
+
+#endif
@@ -1,15 +1,26 @@
 #pragma once
 
 #include "RuntimeException.hpp"
+#include "TypeIndex.hpp"
 #include <memory>
-#include <unordered_map>
+#include <memory_resource>
+#include <utility>
+#include <vector>
 
 namespace ECS {
 /**
- * @brief ResourceManager is a container for Resources
+ * @brief ResourceManager is a container for Resources, stored in a vector indexed by the TypeIndex of their type
  */
 class ResourceManager {
 public:
+    /**
+     * @brief Construct a new ResourceManager object
+     * @param resource Memory resource the resources are allocated from
+     */
+    explicit ResourceManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : memory_resource(resource)
+    {
+    }
     /**
      * @brief Register a new resource type
      * @tparam ResourceT Type of the resource to register
@@ -18,14 +29,16 @@ public:
      * @return A shared pointer to the resource
      */
     template<typename ResourceT, typename... Args>
-    std::shared_ptr<ResourceT> registerResource(Args... args)
+    std::shared_ptr<ResourceT> registerResource(Args&&... args)
     {
-        const char* type_name = typeid(ResourceT).name();
-        if (type_name_to_resource.find(type_name) != type_name_to_resource.end()) {
+        std::size_t index = TypeIndex<ResourceFamily>::get<ResourceT>();
+        if (index < resources.size() && resources[index]) {
             throw RuntimeException("ResourceManager::registerResource", "This Resource Type has already been registered");
         }
-        auto resource = std::make_shared<ResourceT>(args...);
-        type_name_to_resource[type_name] = resource;
+        if (index >= resources.size())
+            resources.resize(index + 1);
+        auto resource = std::allocate_shared<ResourceT>(std::pmr::polymorphic_allocator<ResourceT>(memory_resource), std::forward<Args>(args)...);
+        resources[index] = resource;
         return (resource);
     }
     /**
@@ -36,15 +49,32 @@ public:
     template<typename ResourceT>
     std::shared_ptr<ResourceT> getResource()
     {
-        const char* type_name = typeid(ResourceT).name();
-        auto find_result = type_name_to_resource.find(type_name);
-        if (find_result == type_name_to_resource.end()) {
+        std::size_t index = TypeIndex<ResourceFamily>::get<ResourceT>();
+        if (index >= resources.size() || !resources[index]) {
             throw RuntimeException("ResourceManager::getResource", "This Resource Type has not been registered yet");
         }
-        return (std::static_pointer_cast<ResourceT>(find_result->second));
+        return (std::static_pointer_cast<ResourceT>(resources[index]));
+    }
+    /**
+     * @brief Get a reference to a resource, without sharing its ownership
+     *
+     * The slot of the type is read directly and no reference count is touched, so threads can call it
+     * concurrently on a hot path. The reference stays valid as long as the manager.
+     * @tparam ResourceT Type of the resource to get, const-qualified for a read-only reference
+     * @return ResourceT& Reference to the resource
+     */
+    template<typename ResourceT>
+    ResourceT& resource()
+    {
+        std::size_t index = TypeIndex<ResourceFamily>::get<ResourceT>();
+
+        if (index >= resources.size() || !resources[index])
+            throw RuntimeException("ResourceManager::resource", "This Resource Type has not been registered yet");
+        return (*static_cast<ResourceT*>(resources[index].get()));
     }
 
 private:
-    std::unordered_map<const char*, std::shared_ptr<void>> type_name_to_resource;
+    std::pmr::memory_resource* memory_resource;
+    std::vector<std::shared_ptr<void>> resources;
 };
 }
@@ -0,0 +1,482 @@
+#pragma once
+
+#include "RuntimeException.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if __has_include(<sys/mman.h>) && __has_include(<sys/uio.h>) && __has_include(<unistd.h>)
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define ECS_SNAPSHOT_POSIX 1
+#endif
+
+namespace ECS {
+/**
+ * @brief Magic number opening every snapshot, "ECSS" in memory order
+ */
+constexpr std::uint32_t SNAPSHOT_MAGIC = 0x53534345;
+/**
+ * @brief Version of the snapshot format, snapshots of another version are rejected
+ */
+constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * @brief Header of a snapshot
+ *
+ * A snapshot is laid out as this header, the entity slots and signatures of the EntityManager,
+ * then one block per component type holding the dense entity array followed by the component data.
+ * Values are stored in the byte order of the machine that wrote the snapshot, the byte order
+ * marker rejects snapshots written with another one.
+ */
+struct SnapshotHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t component_count;
+};
+
+/**
+ * @brief Header of the block of a component type in a snapshot
+ */
+struct SnapshotComponentHeader {
+    std::uint32_t component_type;
+    std::uint32_t component_size;
+    std::uint32_t count;
+    std::uint32_t trivially_copyable;
+    std::uint64_t payload_size;
+};
+
+/**
+ * @brief Header of the entities of a snapshot
+ */
+struct SnapshotEntityHeader {
+    std::uint32_t slot_count;
+    std::uint32_t free_list;
+    std::uint32_t alive_count;
+    std::uint32_t signature_size;
+};
+
+/**
+ * @brief Entities of a snapshot read in place by the validation, to check the component blocks against them
+ */
+struct SnapshotEntities {
+    std::span<const Entity> slots;
+    std::span<const Signature> signatures;
+};
+
+/**
+ * @brief Magic number opening every delta, "ECSD" in memory order
+ */
+constexpr std::uint32_t DELTA_MAGIC = 0x44534345;
+
+/**
+ * @brief Header of a delta between two ticks
+ *
+ * A delta is laid out as this header, the entities created and destroyed since the first tick,
+ * then one block per component type whose changes are tracked, holding the entities that lost the
+ * component, the entities whose component was added or changed and the components themselves.
+ */
+struct SnapshotDeltaHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t since_tick;
+    std::uint32_t tick;
+    std::uint32_t created_count;
+    std::uint32_t destroyed_count;
+    std::uint32_t component_count;
+};
+
+/**
+ * @brief Header of the block of a component type in a delta
+ */
+struct SnapshotDeltaComponentHeader {
+    std::uint32_t component_type;
+    std::uint32_t component_size;
+    std::uint32_t trivially_copyable;
+    std::uint32_t removed_count;
+    std::uint32_t changed_count;
+    std::uint32_t reserved;
+    std::uint64_t payload_size;
+};
+
+/**
+ * @brief Alignment of the arrays of a snapshot relative to its start
+ */
+constexpr std::size_t SNAPSHOT_ALIGNMENT = 8;
+
+class SnapshotWriter;
+class SnapshotReader;
+
+/**
+ * @brief Serializer converts components that are not trivially copyable, specialize it to snapshot such a component
+ *
+ * A specialization provides `static void save(SnapshotWriter&, const ComponentT&)` and
+ * `static ComponentT load(SnapshotReader&)`. Trivially copyable components are copied as raw bytes
+ * and do not need one.
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+struct Serializer {
+};
+
+/**
+ * @brief Check if a component type has a Serializer specialization
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+concept HasSerializer = requires(SnapshotWriter& writer, SnapshotReader& reader, const ComponentT& component) {
+    Serializer<ComponentT>::save(writer, component);
+    { Serializer<ComponentT>::load(reader) } -> std::convertible_to<ComponentT>;
+};
+
+/**
+ * @brief SnapshotWriter gathers the segments of a snapshot before writing them in one go
+ *
+ * Large contiguous arrays are referenced in place and only copied when the snapshot is written,
+ * with a single writev per batch of segments on POSIX systems. Small values are copied into
+ * buffers owned by the writer, whose capacity is reserved up front so that they never move.
+ */
+class SnapshotWriter {
+public:
+    SnapshotWriter() = default;
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+    /**
+     * @brief Append bytes by copying them
+     * @param data Bytes to append
+     * @param size Number of bytes
+     * @return std::byte* Address of the copy, stays valid as long as the writer so that it can be patched
+     */
+    std::byte* write(const void* data, std::size_t size)
+    {
+        if (size == 0)
+            return (nullptr);
+        if (buffers.empty() || buffers.back().size() + size > buffers.back().capacity()) {
+            buffers.emplace_back();
+            buffers.back().reserve(std::max(SCRATCH_SIZE, size));
+            appending = false;
+        }
+        if (!appending) {
+            segments.push_back(Segment { buffers.back().data() + buffers.back().size(), 0 });
+            appending = true;
+        }
+        const std::byte* bytes = static_cast<const std::byte*>(data);
+
+        std::byte* copy = buffers.back().data() + buffers.back().size();
+
+        buffers.back().insert(buffers.back().end(), bytes, bytes + size);
+        segments.back().size += size;
+        total_size += size;
+        return (copy);
+    }
+    /**
+     * @brief Append a trivially copyable value by copying it
+     * @param value Value to append
+     * @return std::byte* Address of the copy, not aligned, to patch it with memcpy
+     */
+    template<typename T>
+    std::byte* write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SnapshotWriter::write only copies trivially copyable values");
+        return (write(&value, sizeof(T)));
+    }
+    /**
+     * @brief Append zeros until the size of the snapshot is a multiple of SNAPSHOT_ALIGNMENT
+     */
+    void align()
+    {
+        static constexpr std::byte zeros[SNAPSHOT_ALIGNMENT] {};
+
+        write(zeros, (SNAPSHOT_ALIGNMENT - total_size % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+    }
+    /**
+     * @brief Append bytes without copying them, they must stay valid and unchanged until the snapshot is written
+     * @param data Bytes to append
+     * @param size Number of bytes
+     */
+    void reference(const void* data, std::size_t size)
+    {
+        if (size == 0)
+            return;
+        segments.push_back(Segment { static_cast<const std::byte*>(data), size });
+        appending = false;
+        total_size += size;
+    }
+    /**
+     * @brief Get the size of the snapshot
+     * @return std::size_t Number of bytes appended so far
+     */
+    std::size_t size() const
+    {
+        return (total_size);
+    }
+    /**
+     * @brief Copy the snapshot to memory
+     * @param output Buffer receiving the snapshot, replaced
+     */
+    void writeTo(std::vector<std::byte>& output) const
+    {
+        output.resize(total_size);
+        std::size_t offset = 0;
+
+        for (const Segment& segment : segments) {
+            std::memcpy(output.data() + offset, segment.data, segment.size);
+            offset += segment.size;
+        }
+    }
+    /**
+     * @brief Write the snapshot to a file, replacing it
+     * @param path Path of the file
+     */
+    void writeTo(const std::string& path) const
+    {
+#ifdef ECS_SNAPSHOT_POSIX
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0)
+            throw RuntimeException("SnapshotWriter::writeTo", "Cannot open " + path);
+        std::vector<iovec> vectors;
+
+        vectors.reserve(segments.size());
+        for (const Segment& segment : segments)
+            vectors.push_back(iovec { const_cast<std::byte*>(segment.data), segment.size });
+        std::size_t first = 0;
+
+        while (first < vectors.size()) {
+            int batch = static_cast<int>(std::min<std::size_t>(vectors.size() - first, IOV_MAX));
+            ssize_t written = ::writev(fd, vectors.data() + first, batch);
+
+            if (written < 0) {
+                ::close(fd);
+                throw RuntimeException("SnapshotWriter::writeTo", "Cannot write " + path);
+            }
+            // a short write leaves part of a segment, resume from there
+            for (std::size_t left = static_cast<std::size_t>(written); left > 0;) {
+                std::size_t step = std::min(left, vectors[first].iov_len);
+
+                vectors[first].iov_base = static_cast<std::byte*>(vectors[first].iov_base) + step;
+                vectors[first].iov_len -= step;
+                left -= step;
+                if (vectors[first].iov_len == 0)
+                    first++;
+            }
+            while (first < vectors.size() && vectors[first].iov_len == 0)
+                first++;
+        }
+        if (::close(fd) != 0)
+            throw RuntimeException("SnapshotWriter::writeTo", "Cannot write " + path);
+#else
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+
+        if (!file)
+            throw RuntimeException("SnapshotWriter::writeTo", "Cannot open " + path);
+        for (const Segment& segment : segments) {
+            if (std::fwrite(segment.data, 1, segment.size, file) != segment.size) {
+                std::fclose(file);
+                throw RuntimeException("SnapshotWriter::writeTo", "Cannot write " + path);
+            }
+        }
+        if (std::fclose(file) != 0)
+            throw RuntimeException("SnapshotWriter::writeTo", "Cannot write " + path);
+#endif
+    }
+
+private:
+    static constexpr std::size_t SCRATCH_SIZE = 4096;
+
+    struct Segment {
+        const std::byte* data;
+        std::size_t size;
+    };
+
+    std::vector<Segment> segments;
+    std::deque<std::vector<std::byte>> buffers;
+    bool appending = false;
+    std::size_t total_size = 0;
+};
+
+/**
+ * @brief SnapshotReader reads a snapshot from memory, checking every read against the end of the snapshot
+ */
+class SnapshotReader {
+public:
+    /**
+     * @brief Construct a new SnapshotReader object
+     * @param data Bytes of the snapshot, must outlive the reader and start at an address aligned to SNAPSHOT_ALIGNMENT
+     */
+    explicit SnapshotReader(std::span<const std::byte> data)
+        : data(data)
+    {
+    }
+    /**
+     * @brief Get the address of the next bytes and move past them
+     * @param size Number of bytes
+     * @return const std::byte* Address of the bytes in the snapshot, not aligned
+     */
+    const std::byte* take(std::size_t size)
+    {
+        if (size > data.size() - offset)
+            throw RuntimeException("SnapshotReader::take", "The snapshot is truncated");
+        const std::byte* bytes = data.data() + offset;
+
+        offset += size;
+        return (bytes);
+    }
+    /**
+     * @brief Get the address of the next array and move past it
+     * @tparam T Type of the elements
+     * @param count Number of elements
+     * @return const T* Address of the array in the snapshot
+     */
+    template<typename T>
+    const T* takeArray(std::size_t count)
+    {
+        if (count > (data.size() - offset) / sizeof(T))
+            throw RuntimeException("SnapshotReader::takeArray", "The snapshot is truncated");
+        const std::byte* bytes = take(count * sizeof(T));
+
+        if (reinterpret_cast<std::uintptr_t>(bytes) % alignof(T) != 0)
+            throw RuntimeException("SnapshotReader::takeArray", "The snapshot is not aligned, load it from memory aligned to SNAPSHOT_ALIGNMENT");
+        return (reinterpret_cast<const T*>(bytes));
+    }
+    /**
+     * @brief Skip the padding written by SnapshotWriter::align
+     */
+    void align()
+    {
+        take((SNAPSHOT_ALIGNMENT - offset % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+    }
+    /**
+     * @brief Get the position of the reader
+     * @return std::size_t Number of bytes read so far
+     */
+    std::size_t position() const
+    {
+        return (offset);
+    }
+    /**
+     * @brief Copy the next bytes
+     * @param destination Address to copy to
+     * @param size Number of bytes
+     */
+    void read(void* destination, std::size_t size)
+    {
+        if (size != 0)
+            std::memcpy(destination, take(size), size);
+    }
+    /**
+     * @brief Read a trivially copyable value
+     * @return T Value read
+     */
+    template<typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "SnapshotReader::read only copies trivially copyable values");
+        T value;
+
+        read(&value, sizeof(T));
+        return (value);
+    }
+    /**
+     * @brief Check if the whole snapshot has been read
+     * @return true if no byte is left, false otherwise
+     */
+    bool atEnd() const
+    {
+        return (offset == data.size());
+    }
+
+private:
+    std::span<const std::byte> data;
+    std::size_t offset = 0;
+};
+
+/**
+ * @brief MappedFile maps a file in memory for reading, or reads it whole where mapping is not available
+ */
+class MappedFile {
+public:
+    /**
+     * @brief Map a file
+     * @param path Path of the file
+     */
+    explicit MappedFile(const std::string& path)
+    {
+#ifdef ECS_SNAPSHOT_POSIX
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat status;
+
+        if (fd < 0)
+            throw RuntimeException("MappedFile::MappedFile", "Cannot open " + path);
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw RuntimeException("MappedFile::MappedFile", "Cannot read " + path);
+        }
+        size = static_cast<std::size_t>(status.st_size);
+        if (size > 0) {
+            void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                throw RuntimeException("MappedFile::MappedFile", "Cannot map " + path);
+            }
+            ::madvise(mapping, size, MADV_SEQUENTIAL);
+            address = static_cast<const std::byte*>(mapping);
+        }
+        ::close(fd);
+#else
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+
+        if (!file)
+            throw RuntimeException("MappedFile::MappedFile", "Cannot open " + path);
+        std::byte chunk[4096];
+        std::size_t read;
+
+        while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+            contents.insert(contents.end(), chunk, chunk + read);
+        std::fclose(file);
+        address = contents.data();
+        size = contents.size();
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+#ifdef ECS_SNAPSHOT_POSIX
+        if (address)
+            ::munmap(const_cast<std::byte*>(address), size);
+#endif
+    }
+    /**
+     * @brief Get the bytes of the file
+     * @return std::span<const std::byte> Contents of the file
+     */
+    std::span<const std::byte> bytes() const
+    {
+        return (std::span<const std::byte>(address, size));
+    }
+
+private:
+    const std::byte* address = nullptr;
+    std::size_t size = 0;
+#ifndef ECS_SNAPSHOT_POSIX
+    std::vector<std::byte> contents;
+#endif
+};
+}
@@ -0,0 +1,675 @@
+#pragma once
+
+#include "ComponentArray.hpp"
+#include "Memory.hpp"
+#include "Observer.hpp"
+#include "RuntimeException.hpp"
+#include "Snapshot.hpp"
+#include "SparseSet.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief Alignment of the field arrays of components stored as a structure of arrays, a cache line and two AVX2 registers
+ */
+constexpr std::size_t SOA_ALIGNMENT = 64;
+
+/**
+ * @brief Specialize SoALayout to store each field of a component in its own dense array
+ *
+ * The specialization lists the data members of the component in a static constexpr tuple named fields,
+ * which must cover every byte of the component so that storing it field by field loses nothing:
+ * @code
+ * template<>
+ * struct ECS::SoALayout<Position> {
+ *     static constexpr auto fields = std::make_tuple(&Position::x, &Position::y, &Position::z);
+ * };
+ * @endcode
+ * The component must be trivially copyable and default constructible, and the specialization visible
+ * wherever the component type is registered. Only the ComponentManager honours it, the archetype
+ * backend keeps storing the component as a whole.
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+struct SoALayout {
+};
+
+/**
+ * @brief Check if a component type has a SoALayout specialization and can be stored field by field
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+concept HasSoALayout = std::is_trivially_copyable_v<ComponentT> && std::is_default_constructible_v<ComponentT> && requires {
+    std::tuple_size<std::remove_cv_t<decltype(SoALayout<ComponentT>::fields)>>::value;
+};
+
+/**
+ * @brief SoAFields describes the fields listed by the SoALayout of a component
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+struct SoAFields {
+    /**
+     * @brief Number of fields
+     */
+    static constexpr std::size_t COUNT = std::tuple_size_v<std::remove_cv_t<decltype(SoALayout<ComponentT>::fields)>>;
+
+    /**
+     * @brief Type of a field
+     * @tparam I Position of the field in the SoALayout
+     */
+    template<std::size_t I>
+    using Type = std::remove_cvref_t<decltype(std::declval<ComponentT&>().*std::get<I>(SoALayout<ComponentT>::fields))>;
+
+    /**
+     * @brief Get the position of a data member in the SoALayout
+     * @tparam Member Pointer to the data member
+     * @return std::size_t Position of the field, COUNT if the member is not listed
+     */
+    template<auto Member>
+    static constexpr std::size_t indexOf()
+    {
+        return (indexOf<Member>(std::make_index_sequence<COUNT>()));
+    }
+    /**
+     * @brief Get the size of every field
+     * @return std::array<std::size_t, COUNT> Size of each field, in the order of the SoALayout
+     */
+    static constexpr std::array<std::size_t, COUNT> sizes()
+    {
+        return (sizes(std::make_index_sequence<COUNT>()));
+    }
+    /**
+     * @brief Call a function with the position of every field, as a std::integral_constant
+     * @param function Function to call
+     */
+    template<typename FunctionT>
+    static void forEach(FunctionT&& function)
+    {
+        forEach(function, std::make_index_sequence<COUNT>());
+    }
+
+private:
+    /**
+     * @brief Find the first field that is the data member
+     */
+    template<auto Member, std::size_t... Is>
+    static constexpr std::size_t indexOf(std::index_sequence<Is...>)
+    {
+        std::size_t index = COUNT;
+
+        ((index = index == COUNT && isMember<Member>(std::get<Is>(SoALayout<ComponentT>::fields)) ? Is : index), ...);
+        return (index);
+    }
+    /**
+     * @brief Check if a field is the data member, members of another type never are
+     */
+    template<auto Member, typename MemberT>
+    static constexpr bool isMember(MemberT member)
+    {
+        if constexpr (std::is_same_v<decltype(Member), MemberT>)
+            return (Member == member);
+        else
+            return (false);
+    }
+    /**
+     * @brief Get the size of every field from the positions of the fields
+     */
+    template<std::size_t... Is>
+    static constexpr std::array<std::size_t, COUNT> sizes(std::index_sequence<Is...>)
+    {
+        return (std::array<std::size_t, COUNT> { sizeof(Type<Is>)... });
+    }
+    /**
+     * @brief Call the function with each position of the fields
+     */
+    template<typename FunctionT, std::size_t... Is>
+    static void forEach(FunctionT& function, std::index_sequence<Is...>)
+    {
+        (function(std::integral_constant<std::size_t, Is>()), ...);
+    }
+};
+
+/**
+ * @brief SoAView exposes the field arrays of a component type stored with a SoALayout as spans
+ *
+ * Position i of every field span and of the entity span belongs to the same entity, so a system can run
+ * a SIMD kernel over the spans of several fields at once. Adding components may reallocate the field
+ * arrays and removing them reorders the entities, both invalidate the view.
+ * @tparam ComponentT Type of the component
+ */
+template<typename ComponentT>
+class SoAView {
+public:
+    using Fields = SoAFields<ComponentT>;
+
+    /**
+     * @brief Construct a new SoAView object
+     * @param entities Entities owning the component, in the order of the field arrays
+     * @param columns Start of each field array
+     */
+    SoAView(const SparseSet& entities, const std::array<std::byte*, Fields::COUNT>& columns)
+        : owners(&entities)
+        , columns(columns)
+    {
+    }
+    /**
+     * @brief Get the number of components
+     * @return std::size_t Length of every span of the view
+     */
+    std::size_t size() const
+    {
+        return (owners->size());
+    }
+    /**
+     * @brief Get the entities owning the component, entities()[i] owns the fields at position i
+     * @return std::span<const Entity> Entities in the order of the field arrays
+     */
+    std::span<const Entity> entities() const
+    {
+        return (std::span<const Entity>(owners->data(), owners->size()));
+    }
+    /**
+     * @brief Check if an entity owns the component
+     * @param entity Entity to check
+     * @return true if the entity owns the component, false otherwise
+     */
+    bool contains(Entity entity) const
+    {
+        return (owners->contains(entity));
+    }
+    /**
+     * @brief Get the position of the fields of an entity
+     * @param entity Entity owning the component
+     * @return std::size_t Position of the entity in every span
+     */
+    std::size_t index(Entity entity) const
+    {
+        return (owners->index(entity));
+    }
+    /**
+     * @brief Get the array of a field, aligned to SOA_ALIGNMENT
+     * @tparam Member Pointer to the data member, listed by the SoALayout
+     * @return std::span<FieldT> Values of the field for every entity
+     */
+    template<auto Member>
+    auto field() const
+    {
+        constexpr std::size_t index = Fields::template indexOf<Member>();
+        static_assert(index < Fields::COUNT, "This data member is not a field of the SoALayout");
+        using FieldT = typename Fields::template Type<index>;
+
+        return (std::span<FieldT>(std::launder(reinterpret_cast<FieldT*>(columns[index])), owners->size()));
+    }
+    /**
+     * @brief Gather the fields at a position into a component
+     * @param index Position of the component, lower than size()
+     * @return ComponentT Copy of the component
+     */
+    ComponentT get(std::size_t index) const
+    {
+        ComponentT component {};
+
+        Fields::forEach([&](auto field) {
+            using FieldT = typename Fields::template Type<decltype(field)::value>;
+
+            component.*std::get<decltype(field)::value>(SoALayout<ComponentT>::fields) = std::launder(reinterpret_cast<FieldT*>(columns[field]))[index];
+        });
+        return (component);
+    }
+    /**
+     * @brief Scatter a component into the fields at a position, without emitting any event
+     * @param index Position of the component, lower than size()
+     * @param component New value of the component
+     */
+    void set(std::size_t index, const ComponentT& component) const
+    {
+        Fields::forEach([&](auto field) {
+            using FieldT = typename Fields::template Type<decltype(field)::value>;
+
+            std::launder(reinterpret_cast<FieldT*>(columns[field]))[index] = component.*std::get<decltype(field)::value>(SoALayout<ComponentT>::fields);
+        });
+    }
+
+private:
+    const SparseSet* owners;
+    std::array<std::byte*, Fields::COUNT> columns;
+};
+
+/**
+ * @brief ComponentArray storing a component with a SoALayout as one dense array per field
+ *
+ * Field arrays are contiguous, allocated from the memory resource of the array with SOA_ALIGNMENT and grown
+ * geometrically, and kept parallel to the dense array of the entity set like the pages of the generic
+ * ComponentArray. Components are not addressable as a whole: they are added, replaced and removed by
+ * value and read or written through the field spans of fields(). Snapshots use the same block format as
+ * the generic ComponentArray, so a snapshot loads whichever layout the component is registered with.
+ * Change tracking is not available.
+ * @tparam ComponentT Type of the components
+ */
+template<typename ComponentT>
+    requires HasSoALayout<ComponentT>
+class ComponentArray<ComponentT> : public IComponentArray {
+public:
+    using Fields = SoAFields<ComponentT>;
+
+    static_assert(std::apply([](auto... sizes) { return ((sizes + ... + std::size_t(0))); }, Fields::sizes()) == sizeof(ComponentT),
+        "The fields of a SoALayout must cover every byte of the component");
+
+    /**
+     * @brief Construct a new ComponentArray object
+     * @param resource Memory resource the field arrays and the entity set are allocated from
+     */
+    explicit ComponentArray(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource)
+        , entities(resource)
+    {
+    }
+    ComponentArray(const ComponentArray&) = delete;
+    ComponentArray& operator=(const ComponentArray&) = delete;
+    /**
+     * @brief Add a new component to an entity
+     * @param entity Entity to add the component to
+     * @param component Component to add, scattered into the field arrays
+     */
+    void insertData(Entity entity, ComponentT component)
+    {
+        if (entities.contains(entity))
+            throw RuntimeException("ComponentArray::insertData", "Entity's component already in corresponding ComponentArray");
+        reserve(entities.size() + 1);
+        fields().set(entities.size(), component);
+        entities.insert(entity);
+        on_construct.emit(entity);
+    }
+    /**
+     * @brief Add the same component to several entities, filling each field array in one run
+     * @param entities Entities to add the component to, none of them may already own it
+     * @param count Number of entities
+     * @param component Component copied to every entity
+     */
+    void insertData(const Entity* entities, std::size_t count, const ComponentT& component)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            if (this->entities.contains(entities[i]))
+                throw RuntimeException("ComponentArray::insertData", "Entity's component already in corresponding ComponentArray");
+        std::size_t first = this->entities.size();
+
+        reserve(first + count);
+        Fields::forEach([&](auto field) {
+            using FieldT = typename Fields::template Type<decltype(field)::value>;
+
+            std::fill_n(column<FieldT>(field) + first, count, component.*std::get<decltype(field)::value>(SoALayout<ComponentT>::fields));
+        });
+        this->entities.reserve(first + count);
+        for (std::size_t i = 0; i < count; i++)
+            this->entities.insert(entities[i]);
+        if (!on_construct.empty())
+            for (std::size_t i = 0; i < count; i++)
+                on_construct.emit(entities[i]);
+    }
+    /**
+     * @brief Overwrite the component of an entity as a whole, emitting a replace event
+     * @param entity Entity owning the component
+     * @param component New value of the component
+     */
+    void replaceData(Entity entity, ComponentT component)
+    {
+        if (!entities.contains(entity))
+            throw RuntimeException("ComponentArray::replaceData", "Entity's component is not contained in corresponding ComponentArray");
+        fields().set(entities.index(entity), component);
+        on_replace.emit(entity);
+    }
+    void insertMoved(Entity entity, void* component) override
+    {
+        insertData(entity, *static_cast<ComponentT*>(component));
+    }
+    /**
+     * @brief Remove component data from an entity
+     * @param entity Entity to remove the data from
+     */
+    void removeData(Entity entity) override
+    {
+        if (!entities.contains(entity))
+            throw RuntimeException("ComponentArray::removeData", "Entity's component is not contained in corresponding ComponentArray");
+        on_destroy.emit(entity);
+        erase(entity);
+    }
+    /**
+     * @brief Signals that an entity has been destroyed and removes the component data from the entity if it exists
+     * @param entity Entity to remove the data from
+     */
+    void entityDestroyed(Entity entity) override
+    {
+        if (entities.contains(entity)) {
+            on_destroy.emit(entity);
+            erase(entity);
+        }
+    }
+    /**
+     * @brief Remove the components of several destroyed entities, compacting the field arrays in one pass
+     * @param destroyed Destroyed entities, without duplicates, those without a component are ignored
+     * @param count Number of entities
+     */
+    void entitiesDestroyed(const Entity* destroyed, std::size_t count) override
+    {
+        std::vector<std::size_t> positions;
+
+        if (!on_destroy.empty())
+            for (std::size_t i = 0; i < count; i++)
+                if (entities.contains(destroyed[i]))
+                    on_destroy.emit(destroyed[i]);
+        // positions are read after the listeners ran, as groups reorder the array on destroy events
+        positions.reserve(count);
+        for (std::size_t i = 0; i < count; i++)
+            if (entities.contains(destroyed[i]))
+                positions.push_back(entities.index(destroyed[i]));
+        entities.erase(std::span<const std::size_t>(positions), [this](std::size_t from, std::size_t to) { moveSlot(from, to); });
+    }
+    /**
+     * @brief Append the entities and components of the array to a snapshot, gathering each component
+     * @param writer Writer of the snapshot
+     * @param type ComponentType of the array, written in the block header
+     */
+    void serialize(SnapshotWriter& writer, ComponentType type) const override
+    {
+        std::byte* header = writer.write(SnapshotComponentHeader { type, sizeof(ComponentT),
+            static_cast<std::uint32_t>(entities.size()), true, 0 });
+        std::size_t payload_start = writer.size();
+        SoAView<ComponentT> view = fields();
+
+        writer.reference(entities.data(), entities.size() * sizeof(Entity));
+        writer.align();
+        for (std::size_t index = 0; index < entities.size(); index++)
+            writer.write(view.get(index));
+        writer.align();
+        std::uint64_t payload_size = writer.size() - payload_start;
+
+        std::memcpy(header + offsetof(SnapshotComponentHeader, payload_size), &payload_size, sizeof(payload_size));
+    }
+    /**
+     * @brief Check that a snapshot block can be loaded into the array
+     * @param header Header of the block
+     * @return true if the block holds trivially copyable components of the same size, false otherwise
+     */
+    bool accepts(const SnapshotComponentHeader& header) const override
+    {
+        return (header.component_size == sizeof(ComponentT) && header.trivially_copyable != 0);
+    }
+    /**
+     * @brief Check that the components of a snapshot block can be read, without loading them
+     * @param reader Reader positioned after the entities of the block, moved past the components
+     * @param header Header of the block, accepted by the array
+     */
+    void validate(SnapshotReader& reader, const SnapshotComponentHeader& header) const override
+    {
+        reader.take(std::size_t(header.count) * sizeof(ComponentT));
+        reader.align();
+    }
+    /**
+     * @brief Replace the content of the array with a snapshot block, scattering each component
+     * @param reader Reader positioned after the header of the block
+     * @param header Header of the block, accepted by the array
+     */
+    void deserialize(SnapshotReader& reader, const SnapshotComponentHeader& header) override
+    {
+        std::size_t count = header.count;
+        const Entity* block_entities = reader.takeArray<Entity>(count);
+
+        reader.align();
+        clear();
+        reserve(count);
+        SoAView<ComponentT> view = fields();
+
+        for (std::size_t index = 0; index < count; index++)
+            view.set(index, reader.read<ComponentT>());
+        entities.assign(block_entities, count);
+        reader.align();
+    }
+    /**
+     * @brief Remove every component, the field arrays are kept
+     */
+    void clear() override
+    {
+        entities.clear();
+    }
+    /**
+     * @brief Replace the content of the array with a copy of another array of the same component type, one memcpy per field
+     * @param source Array to copy, a ComponentArray<ComponentT>
+     */
+    void copyFrom(const IComponentArray& source) override
+    {
+        const ComponentArray& other = static_cast<const ComponentArray&>(source);
+
+        entities.clear();
+        reserve(other.entities.size());
+        for (std::size_t field = 0; field < Fields::COUNT; field++)
+            if (other.entities.size() != 0)
+                std::memcpy(columns[field].get(), other.columns[field].get(), other.entities.size() * FIELD_SIZES[field]);
+        entities.copyFrom(other.entities);
+    }
+    bool isCloneable() const override
+    {
+        return (true);
+    }
+    void enableChangeTracking(const std::uint32_t*) override
+    {
+        throw RuntimeException("ComponentArray::enableChangeTracking", "Change tracking is not available for components stored with a SoALayout");
+    }
+    bool tracksChanges() const override
+    {
+        return (false);
+    }
+    void serializeChanges(SnapshotWriter&, ComponentType, std::uint32_t) const override
+    {
+        throw RuntimeException("ComponentArray::serializeChanges", "Change tracking is not available for components stored with a SoALayout");
+    }
+    bool accepts(const SnapshotDeltaComponentHeader&) const override
+    {
+        return (false);
+    }
+    void deserializeChanges(SnapshotReader&, const SnapshotDeltaComponentHeader&, std::vector<Entity>&, std::vector<Entity>&) override
+    {
+        throw RuntimeException("ComponentArray::deserializeChanges", "Change tracking is not available for components stored with a SoALayout");
+    }
+    void discardChanges(std::uint32_t) override
+    {
+    }
+    /**
+     * @brief Check if the component array has an entity
+     * @param entity Entity to check
+     * @return true If the entity is in the component array, false otherwise
+     */
+    bool hasEntity(Entity entity)
+    {
+        return (entities.contains(entity));
+    }
+    /**
+     * @brief Get the entities owning a component, in the order of the field arrays
+     * @return const SparseSet& Set of the entities
+     */
+    const SparseSet& getEntities() const
+    {
+        return (entities);
+    }
+    /**
+     * @brief Get the number of components in the array
+     * @return std::size_t Number of components
+     */
+    std::size_t size() const
+    {
+        return (entities.size());
+    }
+    /**
+     * @brief Get the field arrays as spans, invalidated by the next insertion or removal
+     * @return SoAView<ComponentT> View over the field arrays
+     */
+    SoAView<ComponentT> fields() const
+    {
+        std::array<std::byte*, Fields::COUNT> starts;
+
+        for (std::size_t field = 0; field < Fields::COUNT; field++)
+            starts[field] = columns[field].get();
+        return (SoAView<ComponentT>(entities, starts));
+    }
+    /**
+     * @brief Exchange the positions of two components in the field arrays, along with their entities
+     * @param left Position of the first component
+     * @param right Position of the second component
+     */
+    void swapPositions(std::size_t left, std::size_t right)
+    {
+        if (left == right)
+            return;
+        for (std::size_t field = 0; field < Fields::COUNT; field++) {
+            std::byte* values = columns[field].get();
+            std::size_t size = FIELD_SIZES[field];
+
+            std::swap_ranges(values + left * size, values + (left + 1) * size, values + right * size);
+        }
+        entities.swapPositions(left, right);
+    }
+    /**
+     * @brief Reorder the leading components of the field arrays
+     * @param order Position each component comes from: the component at order[i] moves to i, must be a permutation of 0 to order.size() - 1
+     */
+    void permute(std::vector<std::size_t> order)
+    {
+        for (std::size_t first = 0; first < order.size(); first++) {
+            std::size_t current = first;
+
+            while (order[current] != first) {
+                std::size_t next = order[current];
+
+                swapPositions(current, next);
+                order[current] = current;
+                current = next;
+            }
+            order[current] = current;
+        }
+    }
+    /**
+     * @brief Sort the components in place, comparing gathered copies, the dense order of the entities follows
+     * @param compare Strict weak ordering of two components
+     * @param count Number of leading components to sort, the whole array by default
+     */
+    template<typename CompareT>
+    void sort(CompareT compare, std::size_t count = std::numeric_limits<std::size_t>::max())
+    {
+        SoAView<ComponentT> view = fields();
+        std::vector<std::size_t> order(std::min(count, entities.size()));
+
+        std::iota(order.begin(), order.end(), std::size_t(0));
+        std::sort(order.begin(), order.end(), [&view, &compare](std::size_t left, std::size_t right) { return (compare(view.get(left), view.get(right))); });
+        permute(std::move(order));
+    }
+    /**
+     * @brief Sort the components in place by a key computed once per component, equal keys keep their order
+     * @param key Function returning the key of a component
+     * @param count Number of leading components to sort, the whole array by default
+     */
+    template<typename KeyT>
+    void sortBy(KeyT key, std::size_t count = std::numeric_limits<std::size_t>::max())
+    {
+        SoAView<ComponentT> view = fields();
+        std::vector<std::pair<std::invoke_result_t<KeyT&, const ComponentT&>, std::size_t>> keys;
+        std::vector<std::size_t> order;
+
+        count = std::min(count, entities.size());
+        keys.reserve(count);
+        for (std::size_t index = 0; index < count; index++)
+            keys.emplace_back(key(view.get(index)), index);
+        std::sort(keys.begin(), keys.end());
+        order.reserve(count);
+        for (const auto& entry : keys)
+            order.push_back(entry.second);
+        permute(std::move(order));
+    }
+    /**
+     * @brief Get the signal of an event
+     * @param event Event to get the signal of
+     * @return Signal& Signal emitted for this event
+     */
+    Signal& getSignal(ComponentEvent event)
+    {
+        switch (event) {
+        case ComponentEvent::Construct:
+            return (on_construct);
+        case ComponentEvent::Destroy:
+            return (on_destroy);
+        default:
+            return (on_replace);
+        }
+    }
+
+private:
+    static constexpr std::array<std::size_t, Fields::COUNT> FIELD_SIZES = Fields::sizes();
+
+    std::pmr::memory_resource* resource;
+    std::array<ResourcePtr<std::byte>, Fields::COUNT> columns;
+    std::size_t capacity = 0;
+    SparseSet entities;
+    Signal on_construct;
+    Signal on_destroy;
+    Signal on_replace;
+
+    /**
+     * @brief Get the typed start of a field array
+     */
+    template<typename FieldT>
+    FieldT* column(std::size_t field) const
+    {
+        return (std::launder(reinterpret_cast<FieldT*>(columns[field].get())));
+    }
+    /**
+     * @brief Grow the field arrays geometrically so that they hold at least a number of components
+     * @param count Number of components the field arrays must hold
+     */
+    void reserve(std::size_t count)
+    {
+        if (count <= capacity)
+            return;
+        // the capacity stays a multiple of 16 so that kernels reading whole registers past the size stay in bounds
+        std::size_t grown = (std::max({ count, capacity * 2, std::size_t(64) }) + 15) / 16 * 16;
+
+        for (std::size_t field = 0; field < Fields::COUNT; field++) {
+            ResourcePtr<std::byte> values = allocateArray<std::byte>(resource, grown * FIELD_SIZES[field], SOA_ALIGNMENT);
+
+            if (entities.size() != 0)
+                std::memcpy(values.get(), columns[field].get(), entities.size() * FIELD_SIZES[field]);
+            columns[field] = std::move(values);
+        }
+        capacity = grown;
+    }
+    /**
+     * @brief Copy the fields of a component to another position
+     */
+    void moveSlot(std::size_t from, std::size_t to)
+    {
+        for (std::size_t field = 0; field < Fields::COUNT; field++)
+            std::memcpy(columns[field].get() + to * FIELD_SIZES[field], columns[field].get() + from * FIELD_SIZES[field], FIELD_SIZES[field]);
+    }
+    /**
+     * @brief Remove the component of an entity by moving the last component in its place
+     */
+    void erase(Entity entity)
+    {
+        std::size_t index = entities.erase(entity);
+
+        if (index != entities.size())
+            moveSlot(entities.size(), index);
+    }
+};
+}
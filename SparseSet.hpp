@@ -0,0 +1,290 @@
+#pragma once
+
+#include "Memory.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief SparseSet is a set of entities backed by a paged sparse array and a packed dense array
+ *
+ * The sparse array maps the index of an entity to its position in the dense array and is split in pages
+ * that are only allocated once an entity of their range is inserted.
+ * Lookups are a page index plus an offset, without any hashing. The dense array stores the full entity,
+ * so a stale handle whose slot was recycled is not contained. Both arrays are allocated from the
+ * memory resource given at construction.
+ */
+class SparseSet {
+public:
+    /**
+     * @brief Number of entries held by one page of the sparse array
+     */
+    static constexpr std::size_t PAGE_SIZE = 4096;
+    /**
+     * @brief Value of a sparse entry that does not point into the dense array
+     */
+    static constexpr std::uint32_t TOMBSTONE = std::numeric_limits<std::uint32_t>::max();
+
+    /**
+     * @brief Construct a new SparseSet object
+     * @param resource Memory resource the sparse pages and the dense array are allocated from
+     */
+    explicit SparseSet(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource)
+        , sparse(resource)
+        , dense(resource)
+    {
+    }
+
+    /**
+     * @brief Check if the set contains an entity
+     * @param entity Entity to check
+     * @return true if the entity is in the set, false otherwise
+     */
+    bool contains(Entity entity) const
+    {
+        std::size_t page = entityIndex(entity) / PAGE_SIZE;
+
+        if (page >= sparse.size() || !sparse[page])
+            return (false);
+        std::uint32_t position = sparse[page][entityIndex(entity) % PAGE_SIZE];
+
+        return (position != TOMBSTONE && dense[position] == entity);
+    }
+    /**
+     * @brief Get the position of an entity in the dense array, the entity must be in the set
+     * @param entity Entity to get the position of
+     * @return std::size_t Position of the entity
+     */
+    std::size_t index(Entity entity) const
+    {
+        return (sparse[entityIndex(entity) / PAGE_SIZE][entityIndex(entity) % PAGE_SIZE]);
+    }
+    /**
+     * @brief Add an entity at the end of the dense array
+     * @param entity Entity to add, must not be in the set
+     */
+    void insert(Entity entity)
+    {
+        assure(entity) = static_cast<std::uint32_t>(dense.size());
+        dense.push_back(entity);
+    }
+    /**
+     * @brief Remove an entity by moving the last entity of the dense array in its place
+     * @param entity Entity to remove, must be in the set
+     * @return std::size_t Position the entity was at, which now holds the previously last entity
+     */
+    std::size_t erase(Entity entity)
+    {
+        std::uint32_t& entry = sparse[entityIndex(entity) / PAGE_SIZE][entityIndex(entity) % PAGE_SIZE];
+        std::uint32_t position = entry;
+        Entity last = dense.back();
+
+        dense[position] = last;
+        sparse[entityIndex(last) / PAGE_SIZE][entityIndex(last) % PAGE_SIZE] = position;
+        entry = TOMBSTONE;
+        dense.pop_back();
+        return (position);
+    }
+    /**
+     * @brief Remove the entities at several positions in one pass over the tail of the dense array
+     *
+     * The holes left below the new size are filled with the entities kept after it, so only the tail of
+     * the dense array moves. The move function is called with the old and new position of each moved
+     * entity, letting the owner of parallel data move it the same way.
+     * @param positions Positions of the entities to remove, in any order and without duplicates
+     * @param move Function called with the source and destination position of each moved entity
+     */
+    template<typename MoveT>
+    void erase(std::span<const std::size_t> positions, MoveT&& move)
+    {
+        std::size_t size = dense.size() - positions.size();
+        std::size_t source = size;
+
+        for (std::size_t position : positions)
+            entry(dense[position]) = TOMBSTONE;
+        for (std::size_t position : positions) {
+            if (position >= size)
+                continue;
+            while (entry(dense[source]) == TOMBSTONE)
+                source++;
+            dense[position] = dense[source];
+            entry(dense[position]) = static_cast<std::uint32_t>(position);
+            move(source++, position);
+        }
+        dense.resize(size);
+    }
+    /**
+     * @brief Exchange the positions of two entities in the dense array
+     * @param left Position of the first entity
+     * @param right Position of the second entity
+     */
+    void swapPositions(std::size_t left, std::size_t right)
+    {
+        Entity left_entity = dense[left];
+        Entity right_entity = dense[right];
+
+        sparse[entityIndex(left_entity) / PAGE_SIZE][entityIndex(left_entity) % PAGE_SIZE] = static_cast<std::uint32_t>(right);
+        sparse[entityIndex(right_entity) / PAGE_SIZE][entityIndex(right_entity) % PAGE_SIZE] = static_cast<std::uint32_t>(left);
+        dense[left] = right_entity;
+        dense[right] = left_entity;
+    }
+    /**
+     * @brief Reserve room in the dense array, growing it geometrically so that repeated small reservations stay amortized
+     * @param capacity Number of entities the dense array must hold without reallocating
+     */
+    void reserve(std::size_t capacity)
+    {
+        if (capacity > dense.capacity())
+            dense.reserve(std::max(capacity, dense.capacity() * 2));
+    }
+    /**
+     * @brief Remove every entity from the set, allocated pages are kept
+     */
+    void clear()
+    {
+        for (Entity entity : dense)
+            sparse[entityIndex(entity) / PAGE_SIZE][entityIndex(entity) % PAGE_SIZE] = TOMBSTONE;
+        dense.clear();
+    }
+    /**
+     * @brief Replace the content of the set, the dense array is copied as a whole and the sparse array filled from it
+     * @param entities Entities of the new dense array, without duplicates
+     * @param count Number of entities
+     */
+    void assign(const Entity* entities, std::size_t count)
+    {
+        clear();
+        dense.assign(entities, entities + count);
+        for (std::size_t position = 0; position < count; position++)
+            assure(entities[position]) = static_cast<std::uint32_t>(position);
+    }
+    /**
+     * @brief Replace the content of the set with a copy of another set, page by page
+     * @param other Set to copy
+     */
+    void copyFrom(const SparseSet& other)
+    {
+        dense.assign(other.dense.begin(), other.dense.end());
+        sparse.resize(other.sparse.size());
+        for (std::size_t page = 0; page < sparse.size(); page++) {
+            if (!other.sparse[page]) {
+                if (sparse[page])
+                    std::fill_n(sparse[page].get(), PAGE_SIZE, TOMBSTONE);
+                continue;
+            }
+            if (!sparse[page])
+                sparse[page] = allocateArray<std::uint32_t>(resource, PAGE_SIZE);
+            std::copy_n(other.sparse[page].get(), PAGE_SIZE, sparse[page].get());
+        }
+    }
+    /**
+     * @brief Release the memory of the set and allocate from another memory resource, the set must be empty
+     * @param resource Memory resource to allocate from
+     */
+    void setMemoryResource(std::pmr::memory_resource* resource)
+    {
+        std::destroy_at(&sparse);
+        std::destroy_at(&dense);
+        this->resource = resource;
+        std::construct_at(&sparse, resource);
+        std::construct_at(&dense, resource);
+    }
+    /**
+     * @brief Get the memory resource the set allocates from
+     * @return std::pmr::memory_resource* Memory resource of the set
+     */
+    std::pmr::memory_resource* getMemoryResource() const
+    {
+        return (resource);
+    }
+    /**
+     * @brief Get the number of entities in the set
+     * @return std::size_t Number of entities
+     */
+    std::size_t size() const
+    {
+        return (dense.size());
+    }
+    /**
+     * @brief Check if the set is empty
+     * @return true if the set has no entity, false otherwise
+     */
+    bool empty() const
+    {
+        return (dense.empty());
+    }
+    /**
+     * @brief Get the packed array of entities
+     * @return const Entity* Pointer to the first entity
+     */
+    const Entity* data() const
+    {
+        return (dense.data());
+    }
+    /**
+     * @brief Get the entity at a position of the dense array
+     * @param position Position of the entity
+     * @return Entity Entity at this position
+     */
+    Entity operator[](std::size_t position) const
+    {
+        return (dense[position]);
+    }
+    /**
+     * @brief Get an iterator to the first entity of the dense array
+     * @return std::pmr::vector<Entity>::const_iterator Iterator to the first entity
+     */
+    std::pmr::vector<Entity>::const_iterator begin() const
+    {
+        return (dense.begin());
+    }
+    /**
+     * @brief Get an iterator past the last entity of the dense array
+     * @return std::pmr::vector<Entity>::const_iterator Iterator past the last entity
+     */
+    std::pmr::vector<Entity>::const_iterator end() const
+    {
+        return (dense.end());
+    }
+
+private:
+    std::pmr::memory_resource* resource;
+    std::pmr::vector<ResourcePtr<std::uint32_t>> sparse;
+    std::pmr::vector<Entity> dense;
+
+    /**
+     * @brief Get the sparse entry of an entity whose page is allocated
+     * @param entity Entity to get the entry of
+     * @return std::uint32_t& Entry of the entity
+     */
+    std::uint32_t& entry(Entity entity)
+    {
+        return (sparse[entityIndex(entity) / PAGE_SIZE][entityIndex(entity) % PAGE_SIZE]);
+    }
+    /**
+     * @brief Get the sparse entry of an entity, allocating its page if needed
+     * @param entity Entity to get the entry of
+     * @return std::uint32_t& Entry of the entity
+     */
+    std::uint32_t& assure(Entity entity)
+    {
+        std::size_t page = entityIndex(entity) / PAGE_SIZE;
+
+        if (page >= sparse.size())
+            sparse.resize(page + 1);
+        if (!sparse[page]) {
+            sparse[page] = allocateArray<std::uint32_t>(resource, PAGE_SIZE);
+            std::fill_n(sparse[page].get(), PAGE_SIZE, TOMBSTONE);
+        }
+        return (sparse[page][entityIndex(entity) % PAGE_SIZE]);
+    }
+};
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+#include "ComponentArray.hpp"
+#include "Observer.hpp"
+#include "Parallel.hpp"
+#include "SoA.hpp"
+#include "SparseSet.hpp"
+#include "ThreadPool.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief Point of the space indexed by a SpatialGrid
+ */
+using SpatialPoint = std::array<float, 3>;
+
+/**
+ * @brief Trait giving the point of a position component, specialize it for components without x, y and z members
+ * @tparam PositionT Type of the position component
+ */
+template<typename PositionT>
+struct SpatialTraits {
+    static SpatialPoint point(const PositionT& position)
+    {
+        return (SpatialPoint { position.x, position.y, position.z });
+    }
+};
+
+/**
+ * @brief Interface of the spatial grids, rebuilt by their coordinator when it replaces its components as a whole
+ */
+class ISpatialGrid {
+public:
+    virtual ~ISpatialGrid() = default;
+    /**
+     * @brief Index every component of the array again, after the array was replaced by a snapshot or a copy
+     */
+    virtual void rebuild() = 0;
+};
+
+/**
+ * @brief SpatialGrid indexes the entities owning a position component in a uniform grid of cubic cells, hashed by coordinates
+ *
+ * The grid observes the ComponentArray of the position: added components and components overwritten
+ * through replaceComponent are collected and moved to their cell in one batch by update(), typically
+ * once per frame, removed components leave the grid at once. When the array tracks changes, update()
+ * also moves the components written since the previous update. Each cell stores the points next to the
+ * entities, so queries read contiguous cells without touching the components. Queries are const and
+ * can run concurrently with each other, not with update(). The grid disconnects from the array when
+ * destroyed, so it must not outlive the coordinator it observes.
+ * @tparam PositionT Type of the position component
+ */
+template<typename PositionT>
+class SpatialGrid : public ISpatialGrid {
+    static_assert(!HasSoALayout<PositionT>, "The position of a SpatialGrid cannot be stored with a SoALayout");
+
+public:
+    /**
+     * @brief Construct a new SpatialGrid object and index the components already in the array
+     * @param array ComponentArray of the position component
+     * @param cell_size Edge length of a cell, about the radius of the common queries
+     * @param tick Current tick of the coordinator, read by update() when the array tracks changes
+     */
+    SpatialGrid(ComponentArray<PositionT>& array, float cell_size, const std::uint32_t* tick)
+        : array(&array)
+        , cell_size(cell_size)
+        , tick(tick)
+        , entities(array.getEntities().getMemoryResource())
+        , items(array.getEntities().getMemoryResource())
+        , cell_indices(array.getEntities().getMemoryResource())
+        , cells(array.getEntities().getMemoryResource())
+    {
+        if (!(cell_size > 0))
+            throw RuntimeException("SpatialGrid::SpatialGrid", "The cell size must be positive");
+        pending.collect(array.getSignal(ComponentEvent::Construct));
+        pending.collect(array.getSignal(ComponentEvent::Replace));
+        pending.discard(array.getSignal(ComponentEvent::Destroy));
+        Signal& destroy = array.getSignal(ComponentEvent::Destroy);
+
+        destroy_connection = destroy.connect([this](Entity entity) { remove(entity); });
+        rebuild();
+    }
+    SpatialGrid(const SpatialGrid&) = delete;
+    SpatialGrid& operator=(const SpatialGrid&) = delete;
+    ~SpatialGrid()
+    {
+        array->getSignal(ComponentEvent::Destroy).disconnect(destroy_connection);
+    }
+    /**
+     * @brief Move the collected entities to the cells of their current position
+     *
+     * With change tracking, the components changed at or after the tick of the previous update are moved
+     * too, found by one scan of the tick array; components changed at that tick are visited twice at most.
+     */
+    void update()
+    {
+        pending.drain([this](Entity entity) { place(entity, array->getEntities().index(entity)); });
+        if (!array->tracksChanges())
+            return;
+        for (std::size_t index = 0; index < array->size(); index++)
+            if (synced_tick == 0 || array->changedSince(index, synced_tick - 1))
+                place(array->getEntities()[index], index);
+        synced_tick = *tick;
+    }
+    /**
+     * @brief Index every component of the array again, after the array was replaced by a snapshot or a copy
+     *
+     * The coordinator that registered the grid calls it after copyFrom and loadSnapshot.
+     */
+    void rebuild() override
+    {
+        entities.clear();
+        items.clear();
+        cell_indices.clear();
+        cells.clear();
+        min_cell.fill(std::numeric_limits<std::int32_t>::max());
+        max_cell.fill(std::numeric_limits<std::int32_t>::min());
+        pending.drain([](Entity) { });
+        for (std::size_t index = 0; index < array->size(); index++)
+            place(array->getEntities()[index], index);
+        synced_tick = *tick;
+    }
+    /**
+     * @brief Get the number of entities in the grid
+     * @return std::size_t Number of entities
+     */
+    std::size_t size() const
+    {
+        return (entities.size());
+    }
+    /**
+     * @brief Call a function on every entity whose point is within a radius of a center
+     * @param center Center of the sphere
+     * @param radius Radius of the sphere, points at this distance are included
+     * @param function Function called with each entity found, in no particular order
+     */
+    template<typename FunctionT>
+    void eachInRadius(const SpatialPoint& center, float radius, FunctionT&& function) const
+    {
+        std::array<std::int32_t, 3> low;
+        std::array<std::int32_t, 3> high;
+        float squared_radius = radius * radius;
+
+        // the box is clamped to the occupied cells, so a huge radius does not walk empty cells
+        for (std::size_t axis = 0; axis < 3; axis++) {
+            low[axis] = std::max(coordinateOf(center[axis] - radius), min_cell[axis]);
+            high[axis] = std::min(coordinateOf(center[axis] + radius), max_cell[axis]);
+        }
+        for (std::int32_t x = low[0]; x <= high[0]; x++)
+            for (std::int32_t y = low[1]; y <= high[1]; y++)
+                for (std::int32_t z = low[2]; z <= high[2]; z++)
+                    if (const std::pmr::vector<Entry>* cell = findCell({ x, y, z }))
+                        for (const Entry& entry : *cell)
+                            if (squaredDistance(entry.point, center) <= squared_radius)
+                                function(entry.entity);
+    }
+    /**
+     * @brief Run radius queries in parallel on a ThreadPool
+     * @param pool ThreadPool running the queries
+     * @param centers Centers of the queries
+     * @param radius Radius of every query
+     * @param function Function called with the index of the query and each entity found, concurrently for different queries
+     */
+    template<typename FunctionT>
+    void eachInRadius(ThreadPool& pool, std::span<const SpatialPoint> centers, float radius, FunctionT&& function) const
+    {
+        parallelFor(pool, centers.size(), [this, centers, radius, &function](std::size_t begin, std::size_t end) {
+            for (std::size_t query = begin; query < end; query++)
+                eachInRadius(centers[query], radius, [&function, query](Entity entity) { function(query, entity); });
+        }, QUERY_CHUNK_SIZE);
+    }
+    /**
+     * @brief Find the entities closest to a point
+     *
+     * Cells are visited in rings of growing distance around the cell of the point, until the k-th closest
+     * entity found is closer than any cell left.
+     * @param center Point to search around
+     * @param k Maximum number of entities to find
+     * @param result Entities found, from the closest to the farthest, replaced
+     */
+    void nearest(const SpatialPoint& center, std::size_t k, std::vector<Entity>& result) const
+    {
+        std::vector<std::pair<float, Entity>> heap;
+
+        result.clear();
+        nearest(center, k, heap);
+        for (const auto& [distance, entity] : heap)
+            result.push_back(entity);
+    }
+    /**
+     * @brief Run nearest neighbour queries in parallel on a ThreadPool
+     * @param pool ThreadPool running the queries
+     * @param centers Points to search around
+     * @param k Maximum number of entities to find per query
+     * @param results k entities per query, from the closest to the farthest, padded with NULL_ENTITY, replaced
+     */
+    void nearest(ThreadPool& pool, std::span<const SpatialPoint> centers, std::size_t k, std::vector<Entity>& results) const
+    {
+        results.assign(centers.size() * k, NULL_ENTITY);
+        parallelFor(pool, centers.size(), [this, centers, k, &results](std::size_t begin, std::size_t end) {
+            std::vector<std::pair<float, Entity>> heap;
+
+            for (std::size_t query = begin; query < end; query++) {
+                nearest(centers[query], k, heap);
+                for (std::size_t i = 0; i < heap.size(); i++)
+                    results[query * k + i] = heap[i].second;
+            }
+        }, QUERY_CHUNK_SIZE);
+    }
+
+private:
+    /**
+     * @brief Entity of a cell with a copy of its point
+     */
+    struct Entry {
+        Entity entity;
+        SpatialPoint point;
+    };
+    /**
+     * @brief Location of an entity in the cells
+     */
+    struct Item {
+        std::uint32_t cell;
+        std::uint32_t slot;
+    };
+
+    static constexpr std::size_t QUERY_CHUNK_SIZE = 64;
+    static constexpr std::uint32_t CELL_COORDINATE_BITS = 21;
+    /**
+     * @brief Bound of the cell coordinates, far enough from the int32 limits for the loops over cells not to overflow
+     */
+    static constexpr std::int32_t CELL_COORDINATE_LIMIT = std::int32_t(1) << 28;
+
+    ComponentArray<PositionT>* array;
+    float cell_size;
+    const std::uint32_t* tick;
+    std::uint32_t synced_tick = 0;
+    ReactiveList pending;
+    Signal::Connection destroy_connection = 0;
+    SparseSet entities;
+    std::pmr::vector<Item> items;
+    std::pmr::unordered_map<std::uint64_t, std::uint32_t> cell_indices;
+    std::pmr::vector<std::pmr::vector<Entry>> cells;
+    std::array<std::int32_t, 3> min_cell;
+    std::array<std::int32_t, 3> max_cell;
+
+    /**
+     * @brief Get the squared distance between two points
+     */
+    static float squaredDistance(const SpatialPoint& left, const SpatialPoint& right)
+    {
+        float x = left[0] - right[0];
+        float y = left[1] - right[1];
+        float z = left[2] - right[2];
+
+        return (x * x + y * y + z * z);
+    }
+    /**
+     * @brief Get the coordinates of the cell containing a point
+     */
+    std::array<std::int32_t, 3> cellOf(const SpatialPoint& point) const
+    {
+        return { coordinateOf(point[0]), coordinateOf(point[1]), coordinateOf(point[2]) };
+    }
+    /**
+     * @brief Get the cell coordinate of a value along an axis, clamped to CELL_COORDINATE_LIMIT before the conversion, NaN giving the lowest one
+     */
+    std::int32_t coordinateOf(float value) const
+    {
+        double coordinate = std::floor(static_cast<double>(value) / cell_size);
+
+        if (!(coordinate > -CELL_COORDINATE_LIMIT))
+            return (-CELL_COORDINATE_LIMIT);
+        if (coordinate > CELL_COORDINATE_LIMIT)
+            return (CELL_COORDINATE_LIMIT);
+        return (static_cast<std::int32_t>(coordinate));
+    }
+    /**
+     * @brief Pack the coordinates of a cell in a key, coordinates wrap around every 2^21 cells
+     */
+    static std::uint64_t keyOf(const std::array<std::int32_t, 3>& cell)
+    {
+        constexpr std::uint64_t MASK = (std::uint64_t(1) << CELL_COORDINATE_BITS) - 1;
+
+        return ((static_cast<std::uint64_t>(cell[0]) & MASK) | ((static_cast<std::uint64_t>(cell[1]) & MASK) << CELL_COORDINATE_BITS)
+            | ((static_cast<std::uint64_t>(cell[2]) & MASK) << (2 * CELL_COORDINATE_BITS)));
+    }
+    /**
+     * @brief Get the entries of a cell, nullptr if no entity was ever in it
+     */
+    const std::pmr::vector<Entry>* findCell(const std::array<std::int32_t, 3>& cell) const
+    {
+        auto found = cell_indices.find(keyOf(cell));
+
+        return (found == cell_indices.end() ? nullptr : &cells[found->second]);
+    }
+    /**
+     * @brief Get the index of a cell, creating it the first time an entity enters it
+     */
+    std::uint32_t assureCell(const std::array<std::int32_t, 3>& cell)
+    {
+        auto [found, inserted] = cell_indices.try_emplace(keyOf(cell), static_cast<std::uint32_t>(cells.size()));
+
+        if (inserted) {
+            cells.emplace_back();
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                min_cell[axis] = std::min(min_cell[axis], cell[axis]);
+                max_cell[axis] = std::max(max_cell[axis], cell[axis]);
+            }
+        }
+        return (found->second);
+    }
+    /**
+     * @brief Add an entity or move it to the cell of the component at a position of the array
+     */
+    void place(Entity entity, std::size_t index)
+    {
+        SpatialPoint point = SpatialTraits<PositionT>::point(array->at(index));
+        std::uint32_t cell = assureCell(cellOf(point));
+
+        if (!entities.contains(entity)) {
+            entities.insert(entity);
+            items.push_back(Item { cell, static_cast<std::uint32_t>(cells[cell].size()) });
+            cells[cell].push_back(Entry { entity, point });
+            return;
+        }
+        Item& item = items[entities.index(entity)];
+
+        if (item.cell == cell) {
+            cells[cell][item.slot].point = point;
+            return;
+        }
+        leaveCell(item);
+        item = Item { cell, static_cast<std::uint32_t>(cells[cell].size()) };
+        cells[cell].push_back(Entry { entity, point });
+    }
+    /**
+     * @brief Remove an entity from the grid before its component is removed
+     */
+    void remove(Entity entity)
+    {
+        if (!entities.contains(entity))
+            return;
+        leaveCell(items[entities.index(entity)]);
+        std::size_t position = entities.erase(entity);
+
+        items[position] = items.back();
+        items.pop_back();
+    }
+    /**
+     * @brief Remove the entry of an entity from its cell, the last entry of the cell takes its slot
+     */
+    void leaveCell(const Item& item)
+    {
+        std::pmr::vector<Entry>& cell = cells[item.cell];
+
+        cell[item.slot] = cell.back();
+        items[entities.index(cell[item.slot].entity)].slot = item.slot;
+        cell.pop_back();
+    }
+    /**
+     * @brief Find the k closest entries to a point, sorted by distance, as pairs of squared distance and entity
+     */
+    void nearest(const SpatialPoint& center, std::size_t k, std::vector<std::pair<float, Entity>>& heap) const
+    {
+        std::array<std::int32_t, 3> origin = cellOf(center);
+        std::int32_t extent = 0;
+
+        heap.clear();
+        if (k == 0 || entities.empty())
+            return;
+        for (std::size_t axis = 0; axis < 3; axis++)
+            extent = std::max({ extent, origin[axis] - min_cell[axis], max_cell[axis] - origin[axis] });
+        for (std::int32_t ring = 0; ring <= extent; ring++) {
+            // once a ring has more cells than the grid holds, for a center far from the entities, scan every cell
+            std::uint64_t side = 2 * static_cast<std::uint64_t>(ring) + 1;
+
+            if (side * side * side - (side - 2) * (side - 2) * (side - 2) > cells.size() && ring > 0) {
+                heap.clear();
+                for (const std::pmr::vector<Entry>& cell : cells)
+                    offer(cell, center, k, heap);
+                break;
+            }
+            for (std::int32_t x = -ring; x <= ring; x++) {
+                for (std::int32_t y = -ring; y <= ring; y++) {
+                    bool face = x == -ring || x == ring || y == -ring || y == ring;
+
+                    for (std::int32_t z = -ring; z <= ring; z += face ? 1 : std::max(1, 2 * ring))
+                        visitCell({ origin[0] + x, origin[1] + y, origin[2] + z }, center, k, heap);
+                }
+            }
+            float reach = static_cast<float>(ring) * cell_size;
+
+            if (heap.size() == k && heap.front().first <= reach * reach)
+                break;
+        }
+        std::sort_heap(heap.begin(), heap.end());
+    }
+    /**
+     * @brief Offer the entries of a cell to a max-heap of the k closest entries
+     */
+    void visitCell(const std::array<std::int32_t, 3>& cell, const SpatialPoint& center, std::size_t k, std::vector<std::pair<float, Entity>>& heap) const
+    {
+        for (std::size_t axis = 0; axis < 3; axis++)
+            if (cell[axis] < min_cell[axis] || cell[axis] > max_cell[axis])
+                return;
+        const std::pmr::vector<Entry>* entries = findCell(cell);
+
+        if (entries)
+            offer(*entries, center, k, heap);
+    }
+    /**
+     * @brief Offer entries to a max-heap of the k closest entries, entries at a NaN distance are skipped
+     */
+    void offer(const std::pmr::vector<Entry>& entries, const SpatialPoint& center, std::size_t k, std::vector<std::pair<float, Entity>>& heap) const
+    {
+        for (const Entry& entry : entries) {
+            float distance = squaredDistance(entry.point, center);
+
+            if (std::isnan(distance))
+                continue;
+            if (heap.size() < k) {
+                heap.emplace_back(distance, entry.entity);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (distance < heap.front().first) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = { distance, entry.entity };
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+    }
+};
+}
@@ -1,7 +1,7 @@
 #pragma once
 
+#include "SparseSet.hpp"
 #include "Types.hpp"
-#include <set>
 
 namespace ECS {
 /**
@@ -9,6 +9,15 @@ namespace ECS {
  */
 class System {
 public:
-    std::set<Entity> entities;
+    virtual ~System() = default;
+    /**
+     * @brief Run the system, called by the SystemManager when the systems are updated
+     */
+    virtual void update() {}
+
+    /**
+     * @brief Entities matching the signature of the system, packed for iteration
+     */
+    SparseSet entities;
 };
 }
@@ -1,33 +1,69 @@
 #pragma once
 
+#include "Profiler.hpp"
 #include "RuntimeException.hpp"
 #include "System.hpp"
+#include "ThreadPool.hpp"
+#include "TypeIndex.hpp"
 #include "Types.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <memory_resource>
+#include <utility>
+#include <vector>
 
 namespace ECS {
 /**
- * @brief SystemManager is a container for Systems
+ * @brief SystemManager is a container for Systems, stored in a vector indexed by the TypeIndex of their type
+ *
+ * Systems are indexed by the component types of their signature, so a signature change only
+ * visits the systems interested in one of the component types that changed.
+ *
+ * Systems can declare the component types they read and write. Updating the systems on a ThreadPool
+ * runs concurrently the systems whose accesses do not conflict, conflicting systems run in their
+ * registration order. A system that declared no access conflicts with every other system. Accesses to
+ * resources are declared the same way, so systems only reading a resource can run concurrently.
+ *
+ * With ECS_ENABLE_PROFILING defined, each system update is recorded by the Profiler with the number of
+ * entities of the system, along with the number of signature changes.
  */
 class SystemManager {
 public:
+    /**
+     * @brief Construct a new SystemManager object
+     * @param resource Memory resource the systems and their entity sets are allocated from
+     */
+    explicit SystemManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource)
+    {
+    }
     /**
      * @brief Register a new system type
      * @tparam SystemT Type of the system to register
+     * @tparam Args Types of the arguments to pass to the constructor of the system
+     * @param args Arguments to pass to the constructor of the system
      * @return A shared pointer to the system
      */
-    template<typename SystemT>
-    std::shared_ptr<SystemT> registerSystem()
+    template<typename SystemT, typename... Args>
+    std::shared_ptr<SystemT> registerSystem(Args&&... args)
     {
-        const char* type_name = typeid(SystemT).name();
+        std::size_t index = TypeIndex<SystemFamily>::get<SystemT>();
 
-        if (type_name_to_system.find(type_name) != type_name_to_system.end()) {
+        if (index < systems.size() && systems[index].system) {
             throw RuntimeException("SystemManager::registerSystem", "This System Type has already been registered");
         }
-        auto system = std::make_shared<SystemT>();
-        type_name_to_system[type_name] = system;
-        type_name_to_system_signature[type_name] = ECS::Signature();
+        if (index >= systems.size())
+            systems.resize(index + 1);
+        auto system = std::allocate_shared<SystemT>(std::pmr::polymorphic_allocator<SystemT>(resource), std::forward<Args>(args)...);
+        system->entities.setMemoryResource(resource);
+        systems[index].system = system;
+        systems[index].signature = ECS::Signature();
+        ECS_PROFILE(systems[index].name = profiler.typeName<SystemT>());
+        registration_order.push_back(index);
+        index_outdated = true;
+        graph_outdated = true;
         return system;
     }
     /**
@@ -38,11 +74,8 @@ public:
     template<typename SystemT>
     void setSignature(Signature signature)
     {
-        const char* type_name = typeid(SystemT).name();
-        if (type_name_to_system.find(type_name) == type_name_to_system.end()) {
-            throw RuntimeException("SystemManager::setSignature", "This System Type has not been registered yet");
-        }
-        type_name_to_system_signature[type_name] = signature;
+        getSlot<SystemT>("SystemManager::setSignature").signature = signature;
+        index_outdated = true;
     }
     /**
      * @brief set a bit of the signature of a system
@@ -53,35 +86,198 @@ public:
     template<typename SystemT>
     void setSignatureBit(size_t position, bool value = true)
     {
-        const char* type_name = typeid(SystemT).name();
-        if (type_name_to_system.find(type_name) == type_name_to_system.end()) {
-            throw RuntimeException("SystemManager::setSignature", "This System Type has not been registered yet");
-        }
-        type_name_to_system_signature[type_name].set(position, value);
+        getSlot<SystemT>("SystemManager::setSignature").signature.set(position, value);
+        index_outdated = true;
+    }
+    /**
+     * @brief set a bit of the component types read by a system
+     * @tparam SystemT Type of the system
+     * @param position The position of the bit to set
+     * @param value The value to set the bit to
+     */
+    template<typename SystemT>
+    void setReadBit(size_t position, bool value = true)
+    {
+        SystemSlot& slot = getSlot<SystemT>("SystemManager::setReadBit");
+
+        slot.reads.set(position, value);
+        slot.declared_access = true;
+        graph_outdated = true;
+    }
+    /**
+     * @brief set a bit of the component types written by a system
+     * @tparam SystemT Type of the system
+     * @param position The position of the bit to set
+     * @param value The value to set the bit to
+     */
+    template<typename SystemT>
+    void setWriteBit(size_t position, bool value = true)
+    {
+        SystemSlot& slot = getSlot<SystemT>("SystemManager::setWriteBit");
+
+        slot.writes.set(position, value);
+        slot.declared_access = true;
+        graph_outdated = true;
+    }
+    /**
+     * @brief set a bit of the resource types read by a system
+     * @tparam SystemT Type of the system
+     * @param position TypeIndex of the resource type in the ResourceFamily, lower than MAX_RESOURCES
+     * @param value The value to set the bit to
+     */
+    template<typename SystemT>
+    void setResourceReadBit(size_t position, bool value = true)
+    {
+        SystemSlot& slot = getSlot<SystemT>("SystemManager::setResourceReadBit");
+
+        if (position >= MAX_RESOURCES)
+            throw RuntimeException("SystemManager::setResourceReadBit", "Too many Resource Types to declare an access to");
+        slot.resource_reads.set(position, value);
+        slot.declared_access = true;
+        graph_outdated = true;
+    }
+    /**
+     * @brief set a bit of the resource types written by a system
+     * @tparam SystemT Type of the system
+     * @param position TypeIndex of the resource type in the ResourceFamily, lower than MAX_RESOURCES
+     * @param value The value to set the bit to
+     */
+    template<typename SystemT>
+    void setResourceWriteBit(size_t position, bool value = true)
+    {
+        SystemSlot& slot = getSlot<SystemT>("SystemManager::setResourceWriteBit");
+
+        if (position >= MAX_RESOURCES)
+            throw RuntimeException("SystemManager::setResourceWriteBit", "Too many Resource Types to declare an access to");
+        slot.resource_writes.set(position, value);
+        slot.declared_access = true;
+        graph_outdated = true;
+    }
+    /**
+     * @brief Update every system, one after the other in registration order
+     */
+    void update()
+    {
+        for (std::size_t index : registration_order)
+            updateSystem(systems[index]);
+    }
+    /**
+     * @brief Update every system on a ThreadPool, running non-conflicting systems concurrently
+     *
+     * Returns once every system has been updated. If systems throw, the first exception is rethrown
+     * after the other systems have run.
+     * @param pool ThreadPool to run the systems on
+     */
+    void update(ThreadPool& pool)
+    {
+        if (graph_outdated)
+            rebuildGraph();
+        std::vector<std::atomic<std::size_t>> remaining(registration_order.size());
+        TaskGroup group(pool);
+
+        for (std::size_t node = 0; node < remaining.size(); node++)
+            remaining[node].store(dependency_counts[node], std::memory_order_relaxed);
+        for (std::size_t node = 0; node < remaining.size(); node++)
+            if (dependency_counts[node] == 0)
+                schedule(group, remaining, node);
+        group.wait();
     }
     /**
-     * @brief handle the destruction of an entity by removing it from all systems
+     * @brief handle the destruction of an entity by removing it from the systems it could match
+     *
+     * Only the systems matching every entity and the systems requiring one of the components of the
+     * signature are visited, the other ones cannot contain the entity.
      * @param entity The entity that has been destroyed
+     * @param signature The signature of the entity before it was destroyed
      */
-    void entityDestroyed(Entity entity)
+    void entityDestroyed(Entity entity, Signature signature)
     {
-        for (auto const& [_, system] : type_name_to_system)
-            system->entities.erase(entity);
+        entitiesDestroyed(&entity, &signature, 1);
+    }
+    /**
+     * @brief handle the destruction of several entities by removing them from the systems they could match
+     * @param entities The entities that have been destroyed
+     * @param signatures The signature of each entity before it was destroyed
+     * @param count The number of entities
+     */
+    void entitiesDestroyed(const Entity* entities, const Signature* signatures, std::size_t count)
+    {
+        if (index_outdated)
+            rebuildIndex();
+        for (std::size_t i = 0; i < count; i++) {
+            visit_stamp++;
+            for (std::size_t index : match_all_systems)
+                leave(systems[index], entities[i]);
+            forEachType(signatures[i], [this, entity = entities[i]](ComponentType type) {
+                for (std::size_t index : systems_by_component[type]) {
+                    if (visits[index] == visit_stamp)
+                        continue;
+                    visits[index] = visit_stamp;
+                    leave(systems[index], entity);
+                }
+            });
+        }
+    }
+    /**
+     * @brief Remove every entity from every system, used before the entities are replaced as a whole
+     */
+    void clearEntities()
+    {
+        for (auto const& slot : systems)
+            if (slot.system)
+                slot.system->entities.clear();
+    }
+    /**
+     * @brief Copy the entity sets of the systems of another SystemManager registering the same systems with the same signatures
+     * @param other SystemManager to copy the entity sets of
+     */
+    void copyEntitiesFrom(const SystemManager& other)
+    {
+        if (systems.size() != other.systems.size())
+            throw RuntimeException("SystemManager::copyEntitiesFrom", "The systems are not registered the same way");
+        for (std::size_t index = 0; index < systems.size(); index++)
+            if (!systems[index].system != !other.systems[index].system || systems[index].signature != other.systems[index].signature)
+                throw RuntimeException("SystemManager::copyEntitiesFrom", "The systems are not registered the same way");
+        for (std::size_t index = 0; index < systems.size(); index++)
+            if (systems[index].system)
+                systems[index].system->entities.copyFrom(other.systems[index].system->entities);
     }
     /**
      * @brief handle the signature change of an entity
      * @param entity The entity that has changed
+     * @param old_signature The signature of the entity before the change
      * @param signature The new signature of the entity
      */
-    void entitySignatureChanged(Entity entity, Signature signature)
+    void entitySignatureChanged(Entity entity, Signature old_signature, Signature signature)
+    {
+        entitiesSignatureChanged(&entity, 1, old_signature, signature);
+    }
+    /**
+     * @brief handle the same signature change on several entities, resolving the interested systems once
+     * @param entities The entities that have changed
+     * @param count The number of entities
+     * @param old_signature The signature of the entities before the change
+     * @param signature The new signature of the entities
+     */
+    void entitiesSignatureChanged(const Entity* entities, std::size_t count, Signature old_signature, Signature signature)
     {
-        for (auto const& [type, system] : type_name_to_system) {
-            auto const& system_signature = type_name_to_system_signature[type];
+        Signature changed = old_signature ^ signature;
 
-            if ((signature & system_signature) == system_signature)
-                system->entities.insert(entity);
-            else
-                system->entities.erase(entity);
+        ECS_PROFILE(profiler.count(Profiler::Counter::SignatureChanged, count));
+        if (index_outdated)
+            rebuildIndex();
+        visit_stamp++;
+        for (std::size_t index : match_all_systems)
+            updateMembership(systems[index], entities, count, signature);
+        for (std::size_t type = 0; type < MAX_COMPONENTS; type++) {
+            if (!changed.test(type))
+                continue;
+            for (std::size_t index : systems_by_component[type]) {
+                if (visits[index] == visit_stamp)
+                    continue;
+                visits[index] = visit_stamp;
+                updateMembership(systems[index], entities, count, signature);
+            }
         }
     }
     /**
@@ -92,16 +288,193 @@ public:
     template<typename SystemT>
     std::shared_ptr<SystemT> getSystem()
     {
-        const char* type_name = typeid(SystemT).name();
-        auto find_result = type_name_to_system.find(type_name);
-        if (find_result == type_name_to_system.end()) {
-            throw RuntimeException("SystemManager::getSystem", "This Resource Type has not been registered yet");
-        }
-        return (std::static_pointer_cast<SystemT>(find_result->second));
+        return (std::static_pointer_cast<SystemT>(getSlot<SystemT>("SystemManager::getSystem").system));
+    }
+    /**
+     * @brief Get a reference to a system, without sharing its ownership
+     * @tparam SystemT Type of the system to get
+     * @return SystemT& Reference to the system, valid as long as the manager
+     */
+    template<typename SystemT>
+    SystemT& system()
+    {
+        return (static_cast<SystemT&>(*getSlot<SystemT>("SystemManager::system").system));
+    }
+#ifdef ECS_ENABLE_PROFILING
+    /**
+     * @brief Get the profiler recording the system updates
+     * @return Profiler& Profiler of the manager
+     */
+    Profiler& getProfiler()
+    {
+        return (profiler);
     }
+#endif
 
 private:
-    std::unordered_map<const char*, Signature> type_name_to_system_signature;
-    std::unordered_map<const char*, std::shared_ptr<System>> type_name_to_system;
+    /**
+     * @brief A registered system and its signature
+     */
+    struct SystemSlot {
+        std::shared_ptr<System> system;
+        Signature signature;
+        Signature reads;
+        Signature writes;
+        ResourceSignature resource_reads;
+        ResourceSignature resource_writes;
+        bool declared_access = false;
+        ECS_PROFILE(const char* name = nullptr;)
+    };
+
+    std::pmr::memory_resource* resource;
+    std::vector<SystemSlot> systems;
+    std::vector<std::size_t> registration_order;
+    std::vector<std::vector<std::size_t>> dependents;
+    std::vector<std::size_t> dependency_counts;
+    bool graph_outdated = false;
+    std::array<std::vector<std::size_t>, MAX_COMPONENTS> systems_by_component;
+    std::vector<std::size_t> match_all_systems;
+    std::vector<std::uint64_t> visits;
+    std::uint64_t visit_stamp = 0;
+    bool index_outdated = false;
+    ECS_PROFILE(Profiler profiler;)
+
+    /**
+     * @brief Rebuild the lists of systems interested in each component type
+     */
+    void rebuildIndex()
+    {
+        for (auto& list : systems_by_component)
+            list.clear();
+        match_all_systems.clear();
+        visits.assign(systems.size(), 0);
+        for (std::size_t index = 0; index < systems.size(); index++) {
+            if (!systems[index].system)
+                continue;
+            if (systems[index].signature.none())
+                match_all_systems.push_back(index);
+            for (std::size_t type = 0; type < MAX_COMPONENTS; type++)
+                if (systems[index].signature.test(type))
+                    systems_by_component[type].push_back(index);
+        }
+        index_outdated = false;
+    }
+    /**
+     * @brief Update a system, timing it when profiling is enabled
+     * @param slot Slot of the system
+     */
+    void updateSystem(SystemSlot& slot)
+    {
+        ECS_PROFILE(Profiler::Scope scope(profiler, slot.name, slot.system->entities.size(), "system"));
+        slot.system->update();
+    }
+    /**
+     * @brief Check if two systems cannot run concurrently
+     * @param first Slot of the first system
+     * @param second Slot of the second system
+     * @return true if one system writes a component or resource type the other reads or writes, or if one declared no access
+     */
+    static bool conflicts(const SystemSlot& first, const SystemSlot& second)
+    {
+        if (!first.declared_access || !second.declared_access)
+            return (true);
+        return ((first.writes & (second.reads | second.writes)).any() || (second.writes & first.reads).any()
+            || (first.resource_writes & (second.resource_reads | second.resource_writes)).any() || (second.resource_writes & first.resource_reads).any());
+    }
+    /**
+     * @brief Rebuild the dependency graph, each system depending on the previously registered systems it conflicts with
+     */
+    void rebuildGraph()
+    {
+        std::size_t count = registration_order.size();
+
+        dependents.assign(count, {});
+        dependency_counts.assign(count, 0);
+        for (std::size_t later = 0; later < count; later++) {
+            for (std::size_t earlier = 0; earlier < later; earlier++) {
+                if (conflicts(systems[registration_order[earlier]], systems[registration_order[later]])) {
+                    dependents[earlier].push_back(later);
+                    dependency_counts[later]++;
+                }
+            }
+        }
+        graph_outdated = false;
+    }
+    /**
+     * @brief Run a system of the graph on the pool, then schedule the dependents it was the last dependency of
+     * @param group TaskGroup of the update
+     * @param remaining Number of dependencies left to run for each node of the graph
+     * @param node Node of the system to run
+     */
+    void schedule(TaskGroup& group, std::vector<std::atomic<std::size_t>>& remaining, std::size_t node)
+    {
+        group.run([this, &group, &remaining, node] {
+            struct ReleaseDependents {
+                SystemManager* manager;
+                TaskGroup& group;
+                std::vector<std::atomic<std::size_t>>& remaining;
+                std::size_t node;
+
+                ~ReleaseDependents()
+                {
+                    for (std::size_t dependent : manager->dependents[node])
+                        if (remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                            manager->schedule(group, remaining, dependent);
+                }
+            } release { this, group, remaining, node };
+
+            updateSystem(systems[registration_order[node]]);
+        });
+    }
+    /**
+     * @brief Insert or remove entities from a system depending on whether their signature matches the signature of the system
+     * @param slot Slot of the system
+     * @param entities The entities to update
+     * @param count The number of entities
+     * @param signature The signature of the entities
+     */
+    static void updateMembership(SystemSlot& slot, const Entity* entities, std::size_t count, Signature signature)
+    {
+        bool matches = (signature & slot.signature) == slot.signature;
+        SparseSet& members = slot.system->entities;
+
+        if (matches)
+            members.reserve(members.size() + count);
+        for (std::size_t i = 0; i < count; i++) {
+            if (matches == members.contains(entities[i]))
+                continue;
+            if (matches)
+                members.insert(entities[i]);
+            else
+                members.erase(entities[i]);
+        }
+    }
+    /**
+     * @brief Remove a destroyed entity from a system if the system contains it
+     * @param slot Slot of the system
+     * @param entity The entity that has been destroyed
+     */
+    static void leave(SystemSlot& slot, Entity entity)
+    {
+        if (slot.system->entities.contains(entity))
+            slot.system->entities.erase(entity);
+    }
+
+    /**
+     * @brief Get the slot of a registered system type
+     * @tparam SystemT Type of the system to get the slot of
+     * @param where Name of the calling function, used in the exception
+     * @return SystemSlot& Slot of the system type
+     */
+    template<typename SystemT>
+    SystemSlot& getSlot(const char* where)
+    {
+        std::size_t index = TypeIndex<SystemFamily>::get<SystemT>();
+
+        if (index >= systems.size() || !systems[index].system) {
+            throw RuntimeException(where, "This System Type has not been registered yet");
+        }
+        return (systems[index]);
+    }
 };
 }
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ECS {
+/**
+ * @brief ThreadPool runs tasks on worker threads that steal from each other
+ *
+ * Each worker owns a queue: it pops its own tasks from the back and steals from the front of the
+ * other queues when its queue is empty. Tasks submitted from a worker go to its own queue, the
+ * others are spread over the queues in turn.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Construct a new ThreadPool object
+     * @param thread_count Number of worker threads, at least one
+     */
+    explicit ThreadPool(std::size_t thread_count = std::max(1u, std::thread::hardware_concurrency()))
+        : queues(std::max<std::size_t>(thread_count, 1))
+    {
+        for (std::size_t index = 0; index < queues.size(); index++)
+            queues[index] = std::make_unique<Queue>();
+        for (std::size_t index = 0; index < queues.size(); index++)
+            workers.emplace_back([this, index] { work(index); });
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_condition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+    /**
+     * @brief Queue a task
+     * @param task Task to run on a worker
+     */
+    void submit(std::function<void()> task)
+    {
+        std::size_t index = worker_index != NOT_A_WORKER && current_pool == this
+            ? worker_index
+            : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        sleep_condition.notify_one();
+    }
+    /**
+     * @brief Run one queued task on the calling thread, used to help while waiting for tasks
+     * @return true if a task was run, false if every queue was empty
+     */
+    bool runPendingTask()
+    {
+        std::function<void()> task;
+        std::size_t home = worker_index != NOT_A_WORKER && current_pool == this ? worker_index : 0;
+
+        if (!take(home, task))
+            return (false);
+        task();
+        return (true);
+    }
+    /**
+     * @brief Get the number of worker threads
+     * @return std::size_t Number of workers
+     */
+    std::size_t size() const
+    {
+        return (workers.size());
+    }
+    /**
+     * @brief Get the index of the calling thread in the pool
+     * @return std::size_t Index of the worker, or size() for a thread that is not a worker of this pool
+     */
+    std::size_t currentThread() const
+    {
+        return (worker_index != NOT_A_WORKER && current_pool == this ? worker_index : workers.size());
+    }
+
+private:
+    static constexpr std::size_t NOT_A_WORKER = static_cast<std::size_t>(-1);
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> next_queue { 0 };
+    std::atomic<std::size_t> queued { 0 };
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_condition;
+    bool stopping = false;
+
+    static inline thread_local std::size_t worker_index = NOT_A_WORKER;
+    static inline thread_local ThreadPool* current_pool = nullptr;
+
+    /**
+     * @brief Take a task, from the back of the home queue first then from the front of the other queues
+     * @param home Index of the queue to look into first
+     * @param task Task taken
+     * @return true if a task was taken, false otherwise
+     */
+    bool take(std::size_t home, std::function<void()>& task)
+    {
+        for (std::size_t offset = 0; offset < queues.size(); offset++) {
+            Queue& queue = *queues[(home + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (queue.tasks.empty())
+                continue;
+            if (offset == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return (true);
+        }
+        return (false);
+    }
+    /**
+     * @brief Loop of a worker thread
+     * @param index Index of the worker
+     */
+    void work(std::size_t index)
+    {
+        worker_index = index;
+        current_pool = this;
+        while (true) {
+            std::function<void()> task;
+
+            if (take(index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+
+            sleep_condition.wait(lock, [this] { return (stopping || queued.load(std::memory_order_acquire) > 0); });
+            if (stopping && queued.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+};
+
+/**
+ * @brief TaskGroup tracks a set of tasks submitted to a ThreadPool so that they can be waited on
+ */
+class TaskGroup {
+public:
+    /**
+     * @brief Construct a new TaskGroup object
+     * @param pool ThreadPool running the tasks
+     */
+    explicit TaskGroup(ThreadPool& pool)
+        : pool(pool)
+    {
+    }
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup()
+    {
+        while (pending.load(std::memory_order_acquire) > 0)
+            if (!pool.runPendingTask())
+                std::this_thread::yield();
+    }
+    /**
+     * @brief Submit a task to the pool as part of the group
+     * @param task Task to run, an exception it throws is rethrown by wait
+     */
+    void run(std::function<void()> task)
+    {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.submit([this, task = std::move(task)] {
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                if (!exception)
+                    exception = std::current_exception();
+            }
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+    /**
+     * @brief Wait for every task of the group, running queued tasks on the calling thread meanwhile
+     */
+    void wait()
+    {
+        while (pending.load(std::memory_order_acquire) > 0)
+            if (!pool.runPendingTask())
+                std::this_thread::yield();
+        if (exception)
+            std::rethrow_exception(std::exchange(exception, nullptr));
+    }
+
+private:
+    ThreadPool& pool;
+    std::atomic<std::size_t> pending { 0 };
+    std::mutex exception_mutex;
+    std::exception_ptr exception;
+};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace ECS {
+/**
+ * @brief Family of the component types
+ */
+struct ComponentFamily;
+/**
+ * @brief Family of the system types
+ */
+struct SystemFamily;
+/**
+ * @brief Family of the resource types
+ */
+struct ResourceFamily;
+/**
+ * @brief Family of the group types
+ */
+struct GroupFamily;
+
+/**
+ * @brief TypeIndex gives every type a dense index, starting at 0 for each family
+ *
+ * The index of a type is assigned the first time it is requested and stays the same for the whole process,
+ * so managers can store per-type data in a vector indexed by it instead of hashing type names.
+ * @tparam FamilyT Family of the types, types of different families are numbered independently
+ */
+template<typename FamilyT>
+class TypeIndex {
+public:
+    /**
+     * @brief Get the index of a type
+     * @tparam T Type to get the index of, cv-qualifiers are ignored
+     * @return std::size_t Index of the type
+     */
+    template<typename T>
+    static std::size_t get()
+    {
+        return (index<std::remove_cv_t<T>>());
+    }
+
+private:
+    /**
+     * @brief Get the index of a cv-unqualified type, assigning it on the first call
+     */
+    template<typename T>
+    static std::size_t index()
+    {
+        static const std::size_t value = counter().fetch_add(1, std::memory_order_relaxed);
+
+        return (value);
+    }
+    /**
+     * @brief Get the counter of the family
+     * @return std::atomic<std::size_t>& Next index to assign
+     */
+    static std::atomic<std::size_t>& counter()
+    {
+        static std::atomic<std::size_t> next(0);
+
+        return (next);
+    }
+};
+}
@@ -1,13 +1,74 @@
 #pragma once
 
+#include <bit>
 #include <bitset>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 
 namespace ECS {
 const std::uint32_t MAX_ENTITIES = 5000;
+const std::uint32_t UNLIMITED_ENTITIES = std::numeric_limits<std::uint32_t>::max();
 const std::uint8_t MAX_COMPONENTS = 32;
+const std::size_t MAX_RESOURCES = 64;
 
+/**
+ * @brief Handle of an entity, made of the index of its slot in the low ENTITY_INDEX_BITS bits and
+ * of the version of the slot in the remaining bits, incremented every time the slot is recycled
+ */
 using Entity = std::uint32_t;
 using ComponentType = std::uint8_t;
 using Signature = std::bitset<MAX_COMPONENTS>;
-}
\ No newline at end of file
+/**
+ * @brief Set of resource types, indexed by the TypeIndex of their type in the ResourceFamily
+ */
+using ResourceSignature = std::bitset<MAX_RESOURCES>;
+
+const std::uint32_t ENTITY_INDEX_BITS = 22;
+const Entity ENTITY_INDEX_MASK = (Entity(1) << ENTITY_INDEX_BITS) - 1;
+const Entity ENTITY_VERSION_MASK = std::numeric_limits<Entity>::max() >> ENTITY_INDEX_BITS;
+/**
+ * @brief Handle that is never alive, its index is past the last slot an EntityManager can hand out
+ */
+const Entity NULL_ENTITY = std::numeric_limits<Entity>::max();
+
+/**
+ * @brief Get the slot index of an entity
+ * @param entity Entity to get the index of
+ * @return std::uint32_t Index of the entity
+ */
+constexpr std::uint32_t entityIndex(Entity entity)
+{
+    return (entity & ENTITY_INDEX_MASK);
+}
+/**
+ * @brief Get the version of an entity
+ * @param entity Entity to get the version of
+ * @return std::uint32_t Version of the entity
+ */
+constexpr std::uint32_t entityVersion(Entity entity)
+{
+    return (entity >> ENTITY_INDEX_BITS);
+}
+/**
+ * @brief Build an entity from a slot index and a version
+ * @param index Index of the entity
+ * @param version Version of the entity, wrapped to the available bits
+ * @return Entity Entity built
+ */
+constexpr Entity makeEntity(std::uint32_t index, std::uint32_t version)
+{
+    return ((index & ENTITY_INDEX_MASK) | ((version & ENTITY_VERSION_MASK) << ENTITY_INDEX_BITS));
+}
+/**
+ * @brief Call a function on every component type of a signature, visiting only the set bits
+ * @param signature Signature to visit
+ * @param function Function called with each ComponentType, in increasing order
+ */
+template<typename FunctionT>
+void forEachType(Signature signature, FunctionT&& function)
+{
+    for (unsigned long long bits = signature.to_ullong(); bits != 0; bits &= bits - 1)
+        function(static_cast<ComponentType>(std::countr_zero(bits)));
+}
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "ComponentManager.hpp"
+#include "Parallel.hpp"
+#include "ThreadPool.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ECS {
+/**
+ * @brief Exclude lists the component types an entity must not own to be part of a View
+ * @tparam ComponentTs Types of the excluded components
+ */
+template<typename... ComponentTs>
+struct Exclude {
+};
+
+template<typename ExcludeT, typename... ComponentTs>
+class View;
+
+/**
+ * @brief View iterates over the entities owning a set of components and none of a set of excluded components
+ *
+ * The ComponentArrays are resolved once when the view is created. Iteration walks the dense array of
+ * the smallest included array and checks the other arrays through their sparse index.
+ * @tparam ExcludeTs Types of the components the entities must not own
+ * @tparam ComponentTs Types of the components the entities must own
+ */
+template<typename... ExcludeTs, typename... ComponentTs>
+class View<Exclude<ExcludeTs...>, ComponentTs...> {
+    static_assert(sizeof...(ComponentTs) > 0, "A View needs at least one component type");
+    static_assert(sizeof...(ComponentTs) <= 64, "A View filters changes on at most 64 component types");
+    static_assert((!HasSoALayout<ComponentTs> && ...), "Components with a SoALayout are iterated through fields<ComponentT>(), they can only be excluded from a View");
+
+public:
+    /**
+     * @brief Construct a new View object
+     * @param component_manager ComponentManager owning the ComponentArrays
+     */
+    explicit View(ComponentManager& component_manager)
+        : component_manager(&component_manager)
+        , arrays(component_manager.getComponentArray<ComponentTs>()...)
+        , excluded_arrays(component_manager.getComponentArray<ExcludeTs>()...)
+    {
+    }
+    /**
+     * @brief Get a view that also excludes entities owning some components
+     * @tparam WithoutTs Types of the components to exclude
+     * @return View with the additional exclusions, keeping the changed filters of this view
+     */
+    template<typename... WithoutTs>
+    View<Exclude<ExcludeTs..., WithoutTs...>, ComponentTs...> without() const
+    {
+        View<Exclude<ExcludeTs..., WithoutTs...>, ComponentTs...> result(*component_manager);
+
+        result.changed_mask = changed_mask;
+        result.changed_since = changed_since;
+        return (result);
+    }
+    /**
+     * @brief Check if an entity is part of the view
+     * @param entity Entity to check
+     * @return true if the entity owns every included component and none of the excluded ones, false otherwise
+     */
+    bool contains(Entity entity) const
+    {
+        return (std::apply([entity](auto*... array) { return ((array->hasEntity(entity) && ...)); }, arrays)
+            && std::apply([entity](auto*... array) { return ((!array->hasEntity(entity) && ...)); }, excluded_arrays)
+            && (changed_mask == 0 || changedSince(entity, std::index_sequence_for<ComponentTs...>())));
+    }
+    /**
+     * @brief Get a view that only keeps entities whose component was added or changed after a tick
+     *
+     * The changes of the component type must be tracked. Iterating a view does not record changes,
+     * use markChanged for components written through it. Can be chained on several component types.
+     * @tparam ChangedT Type of the component, one of the included components
+     * @param since Tick to compare with, typically the tick of the previous run
+     * @return View with the additional filter
+     */
+    template<typename ChangedT>
+    View changed(std::uint32_t since) const
+    {
+        static_assert((std::is_same_v<ChangedT, ComponentTs> || ...), "The changed component must be one of the included components");
+        if (!std::get<ComponentArray<ChangedT>*>(arrays)->tracksChanges())
+            throw RuntimeException("View::changed", "Changes of this component type are not tracked");
+        View result(*this);
+        std::size_t position = 0;
+
+        ((std::is_same_v<ChangedT, ComponentTs> ? (result.changed_mask |= std::uint64_t(1) << position++) : position++), ...);
+        result.changed_since = since;
+        return (result);
+    }
+    /**
+     * @brief Get an upper bound of the number of entities in the view
+     * @return std::size_t Size of the smallest included ComponentArray
+     */
+    std::size_t sizeHint() const
+    {
+        return (smallest().size());
+    }
+    /**
+     * @brief Call a function on every entity of the view
+     *
+     * The function is called either with the entity followed by a reference to each included component,
+     * or with the component references only. Components must not be added to or removed from the
+     * iterated arrays during the iteration.
+     * @param function Function to call
+     */
+    template<typename FunctionT>
+    void each(FunctionT&& function) const
+    {
+        const SparseSet& entities = smallest();
+
+        for (std::size_t index = 0; index < entities.size(); index++) {
+            Entity entity = entities[index];
+
+            if (contains(entity))
+                call(function, entity, std::index_sequence_for<ComponentTs...>());
+        }
+    }
+    /**
+     * @brief Call a function on every entity of the view, splitting the smallest array in chunks run on a ThreadPool
+     *
+     * The function has the same form as for each and may be called concurrently from several threads,
+     * use a PerThread to accumulate results. No component may be added or removed during the call.
+     * @param pool ThreadPool running the chunks
+     * @param function Function to call
+     * @param chunk_size Number of entities of a chunk, 0 to use defaultChunkSize
+     */
+    template<typename FunctionT>
+    void parallelEach(ThreadPool& pool, FunctionT&& function, std::size_t chunk_size = 0) const
+    {
+        const SparseSet& entities = smallest();
+
+        parallelFor(pool, entities.size(), [this, &entities, &function](std::size_t begin, std::size_t end) {
+            for (std::size_t index = begin; index < end; index++) {
+                Entity entity = entities[index];
+
+                if (contains(entity))
+                    call(function, entity, std::index_sequence_for<ComponentTs...>());
+            }
+        }, chunk_size);
+    }
+
+private:
+    template<typename ExcludeT, typename... Ts>
+    friend class View;
+
+    ComponentManager* component_manager;
+    std::tuple<ComponentArray<ComponentTs>*...> arrays;
+    std::tuple<ComponentArray<ExcludeTs>*...> excluded_arrays;
+    std::uint64_t changed_mask = 0;
+    std::uint32_t changed_since = 0;
+
+    /**
+     * @brief Get the entities of the smallest included ComponentArray
+     * @return const SparseSet& Entities of the smallest array
+     */
+    const SparseSet& smallest() const
+    {
+        const SparseSet* result = &std::get<0>(arrays)->getEntities();
+
+        std::apply([&result](auto*... array) { ((result = array->size() < result->size() ? &array->getEntities() : result), ...); }, arrays);
+        return (*result);
+    }
+    /**
+     * @brief Check that every component filtered by changed was changed after the tick, the entity must own all of them
+     */
+    template<std::size_t... Is>
+    bool changedSince(Entity entity, std::index_sequence<Is...>) const
+    {
+        return (((!(changed_mask >> Is & 1)) || std::get<Is>(arrays)->changedSince(std::get<Is>(arrays)->getEntities().index(entity), changed_since)) && ...);
+    }
+    /**
+     * @brief Call the function with the components of an entity
+     */
+    template<typename FunctionT, std::size_t... Is>
+    void call(FunctionT& function, Entity entity, std::index_sequence<Is...>) const
+    {
+        if constexpr (std::is_invocable_v<FunctionT&, Entity, ComponentTs&...>)
+            function(entity, std::get<Is>(arrays)->at(std::get<Is>(arrays)->getEntities().index(entity))...);
+        else
+            function(std::get<Is>(arrays)->at(std::get<Is>(arrays)->getEntities().index(entity))...);
+    }
+};
+}
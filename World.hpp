@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Coordinator.hpp"
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+namespace ECS {
+/**
+ * @brief World is a Coordinator built from a setup shared by every world of the same kind
+ *
+ * The setup registers the component types, systems, signatures and resources of a world. Running the
+ * same setup on each world gives every world the same ComponentTypes and systems, which is what lets
+ * clone and copyFrom copy the storage as a whole. Any number of worlds can live in the same process,
+ * each with its own entities, components, systems and memory resource.
+ */
+class World final : public Coordinator {
+public:
+    /**
+     * @brief Function registering the types, systems and resources of a world
+     */
+    using Setup = std::function<void(Coordinator&)>;
+
+    /**
+     * @brief Construct a new World object and run the setup on it
+     * @param setup Setup shared with the other worlds of the same kind
+     * @param max_entities Maximum number of entities alive at the same time, UNLIMITED_ENTITIES to remove the limit
+     * @param resource Memory resource the world allocates its storage from, must outlive the world
+     */
+    explicit World(std::shared_ptr<const Setup> setup, std::uint32_t max_entities = MAX_ENTITIES, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : Coordinator(max_entities, resource)
+        , setup(std::move(setup))
+        , max_entities(max_entities)
+        , resource(resource)
+    {
+        (*this->setup)(*this);
+    }
+    /**
+     * @brief Create a new world of the same kind holding a copy of the entities and components of this one
+     *
+     * Pools of trivially copyable components are copied with memcpy, page by page, other component types
+     * must specialize Cloneable to be copy-constructed. Systems and resources are the fresh ones created
+     * by the setup, only the entity sets of the systems are copied. Spatial grids registered by the setup
+     * are rebuilt from the copied components.
+     * @param resource Memory resource of the clone, nullptr to use the one of this world
+     * @return std::unique_ptr<World> Clone of the world
+     */
+    std::unique_ptr<World> clone(std::pmr::memory_resource* resource = nullptr) const
+    {
+        auto world = std::make_unique<World>(setup, max_entities, resource ? resource : this->resource);
+
+        world->copyFrom(*this);
+        return (world);
+    }
+    /**
+     * @brief Get the setup shared by the worlds of this kind
+     * @return const std::shared_ptr<const Setup>& Setup of the world
+     */
+    const std::shared_ptr<const Setup>& getSetup() const
+    {
+        return (setup);
+    }
+
+private:
+    std::shared_ptr<const Setup> setup;
+    std::uint32_t max_entities;
+    std::pmr::memory_resource* resource;
+};
+}
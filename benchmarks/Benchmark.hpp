@@ -0,0 +1,182 @@
+// Minimal micro-benchmark harness shared by the benchmarks, results are printed as text, JSON or CSV.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Benchmark {
+/**
+ * @brief Prevent the compiler from optimizing a value away
+ * @param value Value to keep
+ */
+template<typename T>
+inline void doNotOptimize(T const& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/**
+ * @brief Timings of one benchmark case
+ */
+struct Result {
+    std::string name;
+    std::string backend;
+    std::size_t entities;
+    std::size_t operations;
+    std::size_t repetitions;
+    double min_ns;
+    double median_ns;
+    double mean_ns;
+};
+
+/**
+ * @brief Runner times benchmark cases and prints their results
+ *
+ * Every case body is run once to warm up then timed over several repetitions. A body must leave the
+ * state it works on as it found it, so that the repetitions measure the same work.
+ * Options: --filter=<substring> --max-entities=<n> --repetitions=<n> --format=text|json|csv --output=<file>
+ */
+class Runner {
+public:
+    /**
+     * @brief Construct a new Runner object from the command line
+     * @param argc Number of arguments
+     * @param argv Arguments
+     */
+    Runner(int argc, char** argv)
+    {
+        for (int index = 1; index < argc; index++) {
+            std::string_view argument(argv[index]);
+
+            if (option(argument, "--filter="))
+                filter = value(argument);
+            else if (option(argument, "--max-entities="))
+                max_entities = std::strtoull(value(argument).c_str(), nullptr, 10);
+            else if (option(argument, "--repetitions="))
+                repetitions = std::max<std::size_t>(1, std::strtoull(value(argument).c_str(), nullptr, 10));
+            else if (option(argument, "--format="))
+                format = value(argument);
+            else if (option(argument, "--output="))
+                output = value(argument);
+            else {
+                std::fprintf(stderr, "usage: %s [--filter=<substring>] [--max-entities=<n>] [--repetitions=<n>] [--format=text|json|csv] [--output=<file>]\n", argv[0]);
+                std::exit(argument == "--help" ? 0 : 1);
+            }
+        }
+    }
+    /**
+     * @brief Check if a case is selected by the command line
+     * @param name Name of the case
+     * @param entities Number of entities of the case
+     * @return true if the case should run, false otherwise
+     */
+    bool enabled(std::string_view name, std::size_t entities) const
+    {
+        return (entities <= max_entities && name.find(filter) != std::string_view::npos);
+    }
+    /**
+     * @brief Time a case, the body is called once per repetition
+     * @param name Name of the case
+     * @param backend Storage backend the case runs on
+     * @param entities Number of entities of the case
+     * @param operations Number of operations done by one call of the body, used to report a time per operation
+     * @param body Work to time
+     */
+    template<typename FunctionT>
+    void run(std::string name, std::string backend, std::size_t entities, std::size_t operations, FunctionT&& body)
+    {
+        std::vector<double> timings;
+
+        body();
+        for (std::size_t repetition = 0; repetition < repetitions; repetition++) {
+            auto start = std::chrono::steady_clock::now();
+
+            body();
+            timings.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(std::max<std::size_t>(operations, 1)));
+        }
+        std::sort(timings.begin(), timings.end());
+        double total = 0;
+
+        for (double timing : timings)
+            total += timing;
+        results.push_back(Result { std::move(name), std::move(backend), entities, operations, repetitions, timings.front(), timings[timings.size() / 2], total / static_cast<double>(timings.size()) });
+        if (format == "text" && output.empty())
+            printText(stdout, results.back());
+    }
+    /**
+     * @brief Print the results in the requested format
+     * @return int Exit code of the program
+     */
+    int report() const
+    {
+        std::FILE* file = output.empty() ? stdout : std::fopen(output.c_str(), "w");
+
+        if (!file) {
+            std::fprintf(stderr, "cannot open %s\n", output.c_str());
+            return (1);
+        }
+        if (format == "json")
+            printJson(file);
+        else if (format == "csv")
+            printCsv(file);
+        else if (!output.empty())
+            for (const Result& result : results)
+                printText(file, result);
+        if (file != stdout)
+            std::fclose(file);
+        return (0);
+    }
+
+private:
+    std::string filter;
+    std::size_t max_entities = static_cast<std::size_t>(-1);
+    std::size_t repetitions = 5;
+    std::string format = "text";
+    std::string output;
+    std::vector<Result> results;
+
+    static bool option(std::string_view argument, std::string_view name)
+    {
+        return (argument.substr(0, name.size()) == name);
+    }
+    static std::string value(std::string_view argument)
+    {
+        return (std::string(argument.substr(argument.find('=') + 1)));
+    }
+    static void printText(std::FILE* file, const Result& result)
+    {
+        std::fprintf(file, "%-28s %-10s %9zu entities  min %10.2f ns/op  median %10.2f ns/op\n",
+            result.name.c_str(), result.backend.c_str(), result.entities, result.min_ns, result.median_ns);
+    }
+    void printJson(std::FILE* file) const
+    {
+        std::fprintf(file, "{\n  \"repetitions\": %zu,\n  \"results\": [", repetitions);
+        for (std::size_t index = 0; index < results.size(); index++) {
+            const Result& result = results[index];
+
+            std::fprintf(file, "%s\n    {\"name\": \"%s\", \"backend\": \"%s\", \"entities\": %zu, \"operations\": %zu, \"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f}",
+                index ? "," : "", result.name.c_str(), result.backend.c_str(), result.entities, result.operations, result.min_ns, result.median_ns, result.mean_ns);
+        }
+        std::fprintf(file, "\n  ]\n}\n");
+    }
+    void printCsv(std::FILE* file) const
+    {
+        std::fprintf(file, "name,backend,entities,operations,repetitions,min_ns,median_ns,mean_ns\n");
+        for (const Result& result : results)
+            std::fprintf(file, "%s,%s,%zu,%zu,%zu,%.3f,%.3f,%.3f\n", result.name.c_str(), result.backend.c_str(),
+                result.entities, result.operations, result.repetitions, result.min_ns, result.median_ns, result.mean_ns);
+    }
+};
+}
@@ -0,0 +1,114 @@
+// Compares the sparse set backed ComponentArray against the previous unordered_map implementation.
+// Build with CMake (target ComponentArrayBenchmark) or from the repository root with: c++ -O2 -std=c++20 -I. benchmarks/ComponentArrayBenchmark.cpp
+
+#include "ComponentArray.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+struct Transform {
+    float x, y, z;
+    float rotation;
+};
+
+/**
+ * @brief Copy of the unordered_map based ComponentArray, kept as the baseline of the benchmark
+ */
+template<typename ComponentT>
+class LegacyComponentArray {
+public:
+    void insertData(ECS::Entity entity, ComponentT component)
+    {
+        entity_to_index[entity] = index_last;
+        index_to_entity[index_last] = entity;
+        component_array[index_last] = component;
+        index_last++;
+    }
+    void removeData(ECS::Entity entity)
+    {
+        std::size_t index_to_delete = entity_to_index[entity];
+        ECS::Entity replacing_entity = index_to_entity[index_last - 1];
+        component_array[entity_to_index[entity]] = component_array[index_last - 1];
+        entity_to_index[replacing_entity] = index_to_delete;
+        index_to_entity[index_to_delete] = replacing_entity;
+        entity_to_index.erase(entity);
+        index_to_entity.erase(index_last - 1);
+        index_last--;
+    }
+    ComponentT& getData(ECS::Entity entity)
+    {
+        if (entity_to_index.find(entity) == entity_to_index.end())
+            throw ECS::RuntimeException("LegacyComponentArray::getData", "Missing component");
+        return (component_array[entity_to_index[entity]]);
+    }
+    bool hasEntity(ECS::Entity entity)
+    {
+        return (entity_to_index.find(entity) != entity_to_index.end());
+    }
+
+private:
+    std::array<ComponentT, ECS::MAX_ENTITIES> component_array;
+    std::unordered_map<ECS::Entity, std::size_t> entity_to_index;
+    std::unordered_map<std::size_t, ECS::Entity> index_to_entity;
+    std::size_t index_last = 0;
+};
+
+template<typename FunctionT>
+double measure(FunctionT&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return (std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+}
+
+template<typename ArrayT>
+void run(const char* name, const std::vector<ECS::Entity>& order)
+{
+    constexpr int ROUNDS = 100;
+    double insert = 0;
+    double get = 0;
+    double has = 0;
+    double remove = 0;
+    float sink = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        auto array = std::make_unique<ArrayT>();
+
+        insert += measure([&] {
+            for (ECS::Entity entity : order)
+                array->insertData(entity, Transform { 1.0f, 2.0f, 3.0f, 0.5f });
+        });
+        get += measure([&] {
+            for (ECS::Entity entity : order)
+                sink += array->getData(entity).x;
+        });
+        has += measure([&] {
+            for (ECS::Entity entity : order)
+                sink += array->hasEntity(entity);
+        });
+        remove += measure([&] {
+            for (ECS::Entity entity : order)
+                array->removeData(entity);
+        });
+    }
+    std::printf("%-16s insert %9.1f us  getData %9.1f us  hasEntity %9.1f us  removeData %9.1f us  (%g)\n",
+        name, insert / ROUNDS, get / ROUNDS, has / ROUNDS, remove / ROUNDS, sink);
+}
+}
+
+int main()
+{
+    std::vector<ECS::Entity> order(ECS::MAX_ENTITIES);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+    run<LegacyComponentArray<Transform>>("unordered_map", order);
+    run<ECS::ComponentArray<Transform>>("sparse set", order);
+    return (0);
+}
@@ -0,0 +1,546 @@
+// Times the core operations of both coordinators from 1k to 1M entities.
+// Build with CMake (target CoreBenchmark) and run with --help for the options, --format=json or csv give
+// machine-readable results that can be compared between runs.
+
+#include "Benchmark.hpp"
+#include "Coordinator.hpp"
+#include "World.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+struct Position {
+    float x, y, z;
+};
+
+struct Velocity {
+    float x, y, z;
+};
+
+struct Health {
+    int value;
+};
+
+struct Mass {
+    float value;
+};
+
+struct Transform {
+    float local[3];
+    float world[3];
+};
+
+struct Children {
+    std::vector<ECS::Entity> entities;
+};
+
+struct Clock {
+    float time;
+};
+
+struct SoAPosition {
+    float x, y, z;
+};
+
+struct SoAVelocity {
+    float x, y, z;
+};
+}
+
+template<>
+struct ECS::SoALayout<SoAPosition> {
+    static constexpr auto fields = std::make_tuple(&SoAPosition::x, &SoAPosition::y, &SoAPosition::z);
+};
+
+template<>
+struct ECS::SoALayout<SoAVelocity> {
+    static constexpr auto fields = std::make_tuple(&SoAVelocity::x, &SoAVelocity::y, &SoAVelocity::z);
+};
+
+namespace {
+template<std::size_t N>
+struct FanOutSystem : ECS::System {
+};
+
+constexpr std::size_t SCALES[] = { 1000, 10000, 100000, 1000000 };
+constexpr std::size_t SYSTEM_COUNTS[] = { 1, 8, 32 };
+
+template<typename CoordinatorT>
+void registerComponents(CoordinatorT& coordinator)
+{
+    coordinator.template registerComponent<Position>();
+    coordinator.template registerComponent<Velocity>();
+    coordinator.template registerComponent<Health>();
+    coordinator.template registerComponent<Mass>();
+}
+
+template<typename CoordinatorT>
+void createDestroy(Benchmark::Runner& runner, const char* backend, std::size_t count)
+{
+    CoordinatorT coordinator(ECS::UNLIMITED_ENTITIES);
+    std::vector<ECS::Entity> entities(count);
+
+    registerComponents(coordinator);
+    runner.run("create_destroy", backend, count, count, [&] {
+        for (ECS::Entity& entity : entities) {
+            entity = coordinator.createEntity();
+            coordinator.addComponent(entity, Position {});
+        }
+        for (ECS::Entity entity : entities)
+            coordinator.destroyEntity(entity);
+    });
+}
+
+template<typename CoordinatorT>
+void addRemove(Benchmark::Runner& runner, const char* backend, std::size_t count)
+{
+    CoordinatorT coordinator(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    std::vector<ECS::Entity> entities = coordinator.createEntities(count, Position {});
+
+    runner.run("add_remove", backend, count, count, [&] {
+        for (ECS::Entity entity : entities)
+            coordinator.addComponent(entity, Velocity {});
+        for (ECS::Entity entity : entities)
+            coordinator.template removeComponent<Velocity>(entity);
+    });
+}
+
+template<typename CoordinatorT>
+void randomGet(Benchmark::Runner& runner, const char* backend, std::size_t count)
+{
+    CoordinatorT coordinator(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    std::vector<ECS::Entity> entities = coordinator.createEntities(count, Position { 1, 2, 3 }, Velocity {});
+
+    std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+    runner.run("get_random", backend, count, count, [&] {
+        float sum = 0;
+
+        for (ECS::Entity entity : entities)
+            sum += coordinator.template getComponent<Position>(entity).x;
+        Benchmark::doNotOptimize(sum);
+    });
+}
+
+template<typename CoordinatorT>
+void iterate(Benchmark::Runner& runner, const char* backend, std::size_t count)
+{
+    CoordinatorT coordinator(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    coordinator.createEntities(count, Position {}, Velocity { 1, 1, 1 }, Health { 100 }, Mass { 1 });
+    if (runner.enabled("iterate_1", count))
+        runner.run("iterate_1", backend, count, count, [&] {
+            coordinator.template each<Position>([](Position& position) { position.x += 1; });
+        });
+    if (runner.enabled("iterate_2", count))
+        runner.run("iterate_2", backend, count, count, [&] {
+            coordinator.template each<Position, Velocity>([](Position& position, Velocity& velocity) {
+                position.x += velocity.x;
+                position.y += velocity.y;
+                position.z += velocity.z;
+            });
+        });
+    if (runner.enabled("iterate_4", count))
+        runner.run("iterate_4", backend, count, count, [&] {
+            coordinator.template each<Position, Velocity, Health, Mass>([](Position& position, Velocity& velocity, Health& health, Mass& mass) {
+                position.x += velocity.x * mass.value;
+                health.value ^= 1;
+            });
+        });
+}
+
+template<typename CoordinatorT, std::size_t... Ss>
+void registerFanOutSystems(CoordinatorT& coordinator, std::index_sequence<Ss...>)
+{
+    ECS::Signature signature;
+
+    signature.set(coordinator.template getComponentType<Position>());
+    signature.set(coordinator.template getComponentType<Velocity>());
+    (coordinator.template registerSystem<FanOutSystem<Ss>>(), ...);
+    (coordinator.template setSignature<FanOutSystem<Ss>>(signature), ...);
+}
+
+template<typename CoordinatorT, std::size_t SystemCount>
+void fanOut(Benchmark::Runner& runner, const char* backend, std::size_t count)
+{
+    CoordinatorT coordinator(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    registerFanOutSystems(coordinator, std::make_index_sequence<SystemCount>());
+    std::vector<ECS::Entity> entities = coordinator.createEntities(count, Position {});
+
+    runner.run("fan_out_" + std::to_string(SystemCount) + "_systems", backend, count, count, [&] {
+        for (ECS::Entity entity : entities)
+            coordinator.addComponent(entity, Velocity {});
+        for (ECS::Entity entity : entities)
+            coordinator.template removeComponent<Velocity>(entity);
+    });
+}
+
+// A wave of projectiles among as many other entities, spawned then despawned in a shuffled order, one
+// entity at a time or in one batch compacting the Position and Velocity pools once.
+template<typename CoordinatorT>
+void destroyBatch(Benchmark::Runner& runner, const char* backend, std::size_t count)
+{
+    CoordinatorT coordinator(ECS::UNLIMITED_ENTITIES);
+    std::mt19937 random(42);
+
+    registerComponents(coordinator);
+    registerFanOutSystems(coordinator, std::make_index_sequence<SYSTEM_COUNTS[1]>());
+    coordinator.createEntities(count, Position {}, Health {});
+    for (bool batch : { false, true }) {
+        std::string name = batch ? "destroy_entities" : "destroy_entity";
+
+        if (!runner.enabled(name, count))
+            continue;
+        runner.run(name, backend, count, count, [&] {
+            std::vector<ECS::Entity> entities = coordinator.createEntities(count, Position {}, Velocity {});
+
+            std::shuffle(entities.begin(), entities.end(), random);
+            if (batch) {
+                coordinator.destroyEntities(entities);
+            } else {
+                for (ECS::Entity entity : entities)
+                    coordinator.destroyEntity(entity);
+            }
+        });
+    }
+}
+
+// Position integration over entities owning both components, kept in lockstep by a group: the AoS
+// kernel reads whole structs, the SoA kernel runs one loop per axis over contiguous float spans.
+void integrate(Benchmark::Runner& runner, std::size_t count)
+{
+    constexpr float DT = 1.0f / 60.0f;
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    coordinator.registerComponent<SoAPosition>();
+    coordinator.registerComponent<SoAVelocity>();
+    if (runner.enabled("integrate_aos", count)) {
+        coordinator.createEntities(count, Position {}, Velocity { 1, 2, 3 });
+        ECS::Group<Position, Velocity>& group = coordinator.group<Position, Velocity>();
+
+        runner.run("integrate_aos", "sparse", count, count, [&] {
+            group.each([](Position& position, const Velocity& velocity) {
+                position.x += velocity.x * DT;
+                position.y += velocity.y * DT;
+                position.z += velocity.z * DT;
+            });
+        });
+    }
+    if (runner.enabled("integrate_soa", count)) {
+        coordinator.createEntities(count, SoAPosition {}, SoAVelocity { 1, 2, 3 });
+        ECS::Group<SoAPosition, SoAVelocity>& group = coordinator.group<SoAPosition, SoAVelocity>();
+        auto axis = [](std::span<float> position, std::span<const float> velocity) {
+            for (std::size_t i = 0; i < position.size(); i++)
+                position[i] += velocity[i] * DT;
+        };
+
+        runner.run("integrate_soa", "sparse", count, count, [&] {
+            ECS::SoAView<SoAPosition> position = coordinator.fields<SoAPosition>();
+            ECS::SoAView<SoAVelocity> velocity = coordinator.fields<SoAVelocity>();
+
+            axis(position.field<&SoAPosition::x>().first(group.size()), velocity.field<&SoAVelocity::x>());
+            axis(position.field<&SoAPosition::y>().first(group.size()), velocity.field<&SoAVelocity::y>());
+            axis(position.field<&SoAPosition::z>().first(group.size()), velocity.field<&SoAVelocity::z>());
+        });
+    }
+}
+
+void snapshot(Benchmark::Runner& runner, std::size_t count)
+{
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+    ECS::Coordinator loaded(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    registerComponents(loaded);
+    coordinator.createEntities(count, Position {}, Velocity {}, Health {}, Mass {});
+    std::vector<std::byte> bytes = coordinator.saveSnapshot();
+
+    if (runner.enabled("snapshot_save", count))
+        runner.run("snapshot_save", "sparse", count, count, [&] { Benchmark::doNotOptimize(coordinator.saveSnapshot()); });
+    if (runner.enabled("snapshot_load", count))
+        runner.run("snapshot_load", "sparse", count, count, [&] { loaded.loadSnapshot(std::span<const std::byte>(bytes)); });
+}
+
+// Forking a world for a rollout: the copy reuses its pages, so this measures the copy itself.
+void worldCopy(Benchmark::Runner& runner, std::size_t count)
+{
+    auto setup = std::make_shared<const ECS::World::Setup>([](ECS::Coordinator& coordinator) {
+        registerComponents(coordinator);
+        registerFanOutSystems(coordinator, std::make_index_sequence<SYSTEM_COUNTS[1]>());
+    });
+    ECS::World world(setup, ECS::UNLIMITED_ENTITIES);
+
+    world.createEntities(count, Position {}, Velocity {}, Health {}, Mass {});
+    std::unique_ptr<ECS::World> copy = world.clone();
+
+    runner.run("world_copy", "sparse", count, count, [&] { copy->copyFrom(world); });
+}
+
+// One tick of replication: 1% of the positions change, the delta is encoded then applied to a replica.
+void delta(Benchmark::Runner& runner, std::size_t count)
+{
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+    ECS::Coordinator replica(ECS::UNLIMITED_ENTITIES);
+
+    for (ECS::Coordinator* world : { &coordinator, &replica }) {
+        registerComponents(*world);
+        world->trackChanges<Position>();
+    }
+    std::vector<ECS::Entity> entities = coordinator.createEntities(count, Position {}, Velocity {}, Health {}, Mass {});
+    std::uint32_t since = coordinator.getTick();
+
+    replica.applyDelta(coordinator.encodeDelta(0));
+    coordinator.discardChanges(since);
+    runner.run("delta_encode_apply", "sparse", count, count / 100, [&] {
+        std::uint32_t tick = coordinator.getTick();
+
+        for (std::size_t i = 0; i < entities.size(); i += 100)
+            coordinator.getComponent<Position>(entities[i]).x += 1.0f;
+        replica.applyDelta(coordinator.encodeDelta(since));
+        coordinator.discardChanges(since);
+        since = tick;
+    });
+}
+
+// Half of the entities own a Velocity, added in reverse order so that the pools disagree on the order:
+// the view follows the Velocity pool and looks up each Position, the group walks both pools in lockstep.
+void groupIterate(Benchmark::Runner& runner, std::size_t count)
+{
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+
+    registerComponents(coordinator);
+    std::vector<ECS::Entity> entities = coordinator.createEntities(count, Position {});
+
+    for (std::size_t i = entities.size(); i-- > 0;)
+        if (i % 2 == 0)
+            coordinator.addComponent(entities[i], Velocity { 1, 1, 1 });
+    auto move = [](Position& position, Velocity& velocity) {
+        position.x += velocity.x;
+        position.y += velocity.y;
+        position.z += velocity.z;
+    };
+
+    if (runner.enabled("view_iterate_2_mixed", count))
+        runner.run("view_iterate_2_mixed", "sparse", count, count / 2, [&] { coordinator.each<Position, Velocity>(move); });
+    if (runner.enabled("group_iterate_2_mixed", count)) {
+        ECS::Group<Position, Velocity>& group = coordinator.group<Position, Velocity>();
+
+        runner.run("group_iterate_2_mixed", "sparse", count, count / 2, [&] { group.each(move); });
+    }
+}
+
+// Transforms of a 4-ary tree whose entities were created in a shuffled order: the recursive pass walks
+// Children vectors with a getComponent per entity, propagate reads the Transform pool in breadth-first
+// order once it is arranged, one depth at a time on a pool for propagate_parallel.
+void propagate(Benchmark::Runner& runner, std::size_t count)
+{
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+    ECS::ThreadPool pool;
+    std::mt19937 random(42);
+
+    coordinator.registerComponent<Transform>();
+    coordinator.registerComponent<Children>();
+    std::vector<ECS::Entity> entities = coordinator.createEntities(count, Transform { { 1, 1, 1 }, {} }, Children {});
+
+    std::shuffle(entities.begin(), entities.end(), random);
+    for (std::size_t i = 1; i < entities.size(); i++) {
+        coordinator.setParent(entities[i], entities[(i - 1) / 4]);
+        coordinator.getComponent<Children>(entities[(i - 1) / 4]).entities.push_back(entities[i]);
+    }
+    auto update = [](const Transform& parent, Transform& child) {
+        for (int axis = 0; axis < 3; axis++)
+            child.world[axis] = parent.world[axis] + child.local[axis];
+    };
+    auto recurse = [&](auto& self, ECS::Entity entity) -> void {
+        const Transform& parent = coordinator.getComponent<Transform>(entity);
+
+        for (ECS::Entity child : coordinator.getComponent<Children>(entity).entities) {
+            update(parent, coordinator.getComponent<Transform>(child));
+            self(self, child);
+        }
+    };
+
+    if (runner.enabled("propagate_recursive", count))
+        runner.run("propagate_recursive", "sparse", count, count, [&] { recurse(recurse, entities[0]); });
+    if (runner.enabled("propagate", count))
+        runner.run("propagate", "sparse", count, count, [&] { coordinator.propagate<Transform>(update); });
+    if (runner.enabled("propagate_parallel", count))
+        runner.run("propagate_parallel", "sparse", count, count, [&] { coordinator.propagate<Transform>(pool, update); });
+}
+
+// Entities moving in a cube sized for about one entity per 64 units^3, indexed by a grid of 16-unit cells:
+// spatial_update moves every entity through getComponent and re-buckets the changed positions, the
+// queries look for the entities within 16 units (or the 8 nearest) of random points, by scanning the
+// whole pool or through the grid.
+void spatial(Benchmark::Runner& runner, std::size_t count)
+{
+    constexpr std::size_t QUERIES = 256;
+    constexpr float RADIUS = 16.0f;
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+    ECS::ThreadPool pool;
+    std::mt19937 random(42);
+    float side = 4.0f * std::cbrt(static_cast<float>(count));
+    std::uniform_real_distribution<float> coordinate(0.0f, side);
+    std::uniform_real_distribution<float> speed(-1.0f, 1.0f);
+    std::vector<ECS::Entity> entities(count);
+    std::vector<ECS::SpatialPoint> centers(QUERIES);
+
+    registerComponents(coordinator);
+    coordinator.trackChanges<Position>();
+    for (ECS::Entity& entity : entities) {
+        entity = coordinator.createEntity();
+        coordinator.addComponent(entity, Position { coordinate(random), coordinate(random), coordinate(random) });
+        coordinator.addComponent(entity, Velocity { speed(random), speed(random), speed(random) });
+    }
+    for (ECS::SpatialPoint& center : centers)
+        center = { coordinate(random), coordinate(random), coordinate(random) };
+    std::shared_ptr<ECS::SpatialGrid<Position>> grid = coordinator.registerSpatialGrid<Position>(RADIUS);
+    std::atomic<std::size_t> found = 0;
+    auto count_found = [&found](std::size_t, ECS::Entity) { found.fetch_add(1, std::memory_order_relaxed); };
+    std::vector<ECS::Entity> nearest;
+
+    if (runner.enabled("spatial_update", count)) {
+        runner.run("spatial_update", "sparse", count, count, [&] {
+            for (ECS::Entity entity : entities) {
+                Position& position = coordinator.getComponent<Position>(entity);
+                const Velocity& velocity = coordinator.readComponent<Velocity>(entity);
+
+                position.x += velocity.x;
+                position.y += velocity.y;
+                position.z += velocity.z;
+            }
+            coordinator.advanceTick();
+            grid->update();
+        });
+    }
+    if (runner.enabled("radius_scan", count)) {
+        runner.run("radius_scan", "sparse", count, QUERIES, [&] {
+            for (const ECS::SpatialPoint& center : centers) {
+                coordinator.each<Position>([&](const Position& position) {
+                    float x = position.x - center[0], y = position.y - center[1], z = position.z - center[2];
+
+                    if (x * x + y * y + z * z <= RADIUS * RADIUS)
+                        found.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    if (runner.enabled("radius_grid", count)) {
+        runner.run("radius_grid", "sparse", count, QUERIES, [&] {
+            for (const ECS::SpatialPoint& center : centers)
+                grid->eachInRadius(center, RADIUS, [&found](ECS::Entity) { found.fetch_add(1, std::memory_order_relaxed); });
+        });
+    }
+    if (runner.enabled("radius_grid_parallel", count))
+        runner.run("radius_grid_parallel", "sparse", count, QUERIES, [&] { grid->eachInRadius(pool, centers, RADIUS, count_found); });
+    if (runner.enabled("nearest_grid", count)) {
+        runner.run("nearest_grid", "sparse", count, QUERIES, [&] {
+            for (const ECS::SpatialPoint& center : centers)
+                grid->nearest(center, 8, nearest);
+        });
+    }
+    if (runner.enabled("nearest_grid_parallel", count))
+        runner.run("nearest_grid_parallel", "sparse", count, QUERIES, [&] { grid->nearest(pool, centers, 8, nearest); });
+    Benchmark::doNotOptimize(found.load());
+}
+
+// Threads of a pool reading a shared resource once per entity: getResource copies a shared_ptr, which
+// increments and decrements a reference count shared by every thread, resource returns a reference.
+void resourceAccess(Benchmark::Runner& runner, std::size_t count)
+{
+    ECS::Coordinator coordinator(ECS::UNLIMITED_ENTITIES);
+    ECS::ThreadPool pool;
+    ECS::PerThread<float> sums(pool, 0.0f);
+
+    coordinator.registerResource<Clock>(Clock { 1.0f });
+    if (runner.enabled("resource_shared_ptr", count)) {
+        runner.run("resource_shared_ptr", "sparse", count, count, [&] {
+            ECS::parallelFor(pool, count, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t index = begin; index < end; index++)
+                    sums.local() += coordinator.getResource<Clock>()->time;
+            });
+        });
+    }
+    if (runner.enabled("resource_ref", count)) {
+        runner.run("resource_ref", "sparse", count, count, [&] {
+            ECS::parallelFor(pool, count, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t index = begin; index < end; index++)
+                    sums.local() += coordinator.resource<const Clock>().time;
+            });
+        });
+    }
+    Benchmark::doNotOptimize(sums.combine(0.0f, [](float left, float right) { return (left + right); }));
+}
+
+template<typename CoordinatorT>
+void runBackend(Benchmark::Runner& runner, const char* backend)
+{
+    for (std::size_t count : SCALES) {
+        if (runner.enabled("create_destroy", count))
+            createDestroy<CoordinatorT>(runner, backend, count);
+        if (runner.enabled("destroy_entity", count) || runner.enabled("destroy_entities", count))
+            destroyBatch<CoordinatorT>(runner, backend, count);
+        if (runner.enabled("add_remove", count))
+            addRemove<CoordinatorT>(runner, backend, count);
+        if (runner.enabled("get_random", count))
+            randomGet<CoordinatorT>(runner, backend, count);
+        if (runner.enabled("iterate_1", count) || runner.enabled("iterate_2", count) || runner.enabled("iterate_4", count))
+            iterate<CoordinatorT>(runner, backend, count);
+        if (runner.enabled("fan_out_1_systems", count))
+            fanOut<CoordinatorT, SYSTEM_COUNTS[0]>(runner, backend, count);
+        if (runner.enabled("fan_out_8_systems", count))
+            fanOut<CoordinatorT, SYSTEM_COUNTS[1]>(runner, backend, count);
+        if (runner.enabled("fan_out_32_systems", count))
+            fanOut<CoordinatorT, SYSTEM_COUNTS[2]>(runner, backend, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("snapshot_save", count) || runner.enabled("snapshot_load", count))
+                snapshot(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("delta_encode_apply", count))
+                delta(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("world_copy", count))
+                worldCopy(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("integrate_aos", count) || runner.enabled("integrate_soa", count))
+                integrate(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("view_iterate_2_mixed", count) || runner.enabled("group_iterate_2_mixed", count))
+                groupIterate(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("propagate_recursive", count) || runner.enabled("propagate", count) || runner.enabled("propagate_parallel", count))
+                propagate(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("spatial_update", count) || runner.enabled("radius_scan", count) || runner.enabled("radius_grid", count)
+                || runner.enabled("radius_grid_parallel", count) || runner.enabled("nearest_grid", count) || runner.enabled("nearest_grid_parallel", count))
+                spatial(runner, count);
+        if constexpr (std::is_same_v<CoordinatorT, ECS::Coordinator>)
+            if (runner.enabled("resource_shared_ptr", count) || runner.enabled("resource_ref", count))
+                resourceAccess(runner, count);
+    }
+}
+}
+
+int main(int argc, char** argv)
+{
+    Benchmark::Runner runner(argc, argv);
+
+    runBackend<ECS::Coordinator>(runner, "sparse");
+    runBackend<ECS::ArchetypeCoordinator>(runner, "archetype");
+    return (runner.report());
+}
@@ -0,0 +1,96 @@
+// Compares spawning entities one addComponent at a time against Coordinator::createEntities, then the
+// same spawn and the teardown of the world with the global allocator and with a PagePoolResource.
+// Build with CMake (target SpawnBenchmark) or from the repository root with: c++ -O2 -std=c++20 -I. benchmarks/SpawnBenchmark.cpp
+
+#include "Coordinator.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <utility>
+
+namespace {
+template<std::size_t N>
+struct Component {
+    float value[4];
+};
+
+template<std::size_t N>
+struct SpawnSystem : ECS::System {
+};
+
+constexpr std::size_t ENTITY_COUNT = 50000;
+constexpr std::size_t SYSTEM_COUNT = 40;
+
+/**
+ * @brief Register 8 component types and 40 systems, each system requiring two of the components
+ */
+template<std::size_t... Cs, std::size_t... Ss>
+void setup(ECS::Coordinator& coordinator, std::index_sequence<Cs...>, std::index_sequence<Ss...>)
+{
+    (coordinator.registerComponent<Component<Cs>>(), ...);
+    (coordinator.registerSystem<SpawnSystem<Ss>>(), ...);
+    (coordinator.setSignature<SpawnSystem<Ss>>(ECS::Signature().set(Ss % 8).set((Ss / 8 + Ss + 1) % 8)), ...);
+}
+
+template<std::size_t... Cs>
+double spawnOneByOne(ECS::Coordinator& coordinator, std::index_sequence<Cs...>)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < ENTITY_COUNT; i++) {
+        ECS::Entity entity = coordinator.createEntity();
+        (coordinator.addComponent(entity, Component<Cs> {}), ...);
+    }
+    return (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+template<std::size_t... Cs>
+double spawnBatched(ECS::Coordinator& coordinator, std::index_sequence<Cs...>)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    coordinator.createEntities(ENTITY_COUNT, Component<Cs> {}...);
+    return (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * @brief Time the destruction of a whole world
+ */
+double tearDown(std::unique_ptr<ECS::Coordinator> coordinator)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    coordinator.reset();
+    return (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+}
+
+int main()
+{
+    auto components = std::make_index_sequence<8>();
+    auto systems = std::make_index_sequence<SYSTEM_COUNT>();
+    ECS::Coordinator one_by_one(ECS::UNLIMITED_ENTITIES);
+    ECS::Coordinator batched(ECS::UNLIMITED_ENTITIES);
+
+    setup(one_by_one, components, systems);
+    setup(batched, components, systems);
+    double loop_time = spawnOneByOne(one_by_one, components);
+    double batch_time = spawnBatched(batched, components);
+    std::printf("%zu entities, 8 components, %zu systems\n", ENTITY_COUNT, SYSTEM_COUNT);
+    std::printf("createEntity + addComponent  %8.2f ms\n", loop_time);
+    std::printf("createEntities               %8.2f ms  (x%.1f)\n", batch_time, loop_time / batch_time);
+
+    ECS::PagePoolResource pool;
+    auto global_world = std::make_unique<ECS::Coordinator>(ECS::UNLIMITED_ENTITIES);
+    auto pooled_world = std::make_unique<ECS::Coordinator>(ECS::UNLIMITED_ENTITIES, &pool);
+
+    setup(*global_world, components, systems);
+    setup(*pooled_world, components, systems);
+    double global_spawn = spawnOneByOne(*global_world, components);
+    double pooled_spawn = spawnOneByOne(*pooled_world, components);
+    double global_teardown = tearDown(std::move(global_world));
+    double pooled_teardown = tearDown(std::move(pooled_world));
+    std::printf("global allocator    spawn %8.2f ms  teardown %8.2f ms\n", global_spawn, global_teardown);
+    std::printf("PagePoolResource    spawn %8.2f ms  teardown %8.2f ms\n", pooled_spawn, pooled_teardown);
+    return (0);
+}